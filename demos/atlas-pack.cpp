@@ -0,0 +1,70 @@
+// Packs images into atlas pages ahead of time (see src/atlas.h)
+//
+// Usage: atlas-pack <output.atlas> <name>=<image.png> ... [<name>=<sheet.png>@<tileW>x<tileH>] ...
+//
+// Writes <output.atlas> plus <output.atlas>-0.png, -1.png, ... next to it.
+// Sheets given as name=file@WxH are split into tiles name:0, name:1, ...
+// Load the result with WY_Atlas::load(renderer, "<output.atlas>").
+
+#include <stdio.h>
+#include <string>
+
+#include "../src/atlas.h"
+
+int main(int argc, char *args[])
+{
+    if (argc < 3)
+    {
+        printf("Usage: %s <output.atlas> <name>=<image.png>[@<tileW>x<tileH>] ...\n", args[0]);
+        return 1;
+    }
+
+    if (IMG_Init(IMG_INIT_PNG) == 0)
+    {
+        printf("SDL_image could not initialize! SDL_image Error: %s\n", IMG_GetError());
+        return 1;
+    }
+
+    WY_Atlas atlas;
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = args[i];
+        size_t eq = arg.find('=');
+        if (eq == std::string::npos)
+        {
+            printf("Expected <name>=<image.png>, got %s\n", args[i]);
+            return 1;
+        }
+
+        std::string name = arg.substr(0, eq);
+        std::string path = arg.substr(eq + 1);
+        int tileW = 0, tileH = 0;
+
+        size_t at = path.rfind('@');
+        if (at != std::string::npos && sscanf(path.c_str() + at + 1, "%dx%d", &tileW, &tileH) == 2)
+        {
+            path = path.substr(0, at);
+            atlas.addTiles(name, path, tileW, tileH);
+        }
+        else
+        {
+            atlas.addImage(name, path);
+        }
+    }
+
+    bool ok = atlas.pack();
+    int nSprites = atlas.getSpriteCount();
+    int nPages = atlas.getPageCount();
+
+    if (!atlas.save(args[1]))
+    {
+        return 1;
+    }
+
+    printf("Packed %d sprites into %d pages: %s\n", nSprites, nPages, args[1]);
+
+    IMG_Quit();
+
+    return ok ? 0 : 1;
+}
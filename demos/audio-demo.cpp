@@ -4,6 +4,7 @@
 
 #include "../src/wyngine.h"
 #include "../src/font.h"
+#include "../src/format.h"
 #include "../src/audio/audio.h"
 #include "../src/audio/instrument.h"
 
@@ -98,6 +99,7 @@ public:
 
                 // Add note to vector
                 vecNotes.emplace_back(n);
+                markTrigger();
             }
             else
             {
@@ -183,13 +185,51 @@ public:
 class Game : public Wyngine
 {
     int frame;
-    WY_Image *mFontImage;
+    WY_ImageHandle mFontImage;
     WY_MonoFont *mFont;
+    WY_StackString<1024> mHud;
     GameAudio *audio;
 
+    int aSampleRateUp, aSampleRateDown, aVolumeUp, aVolumeDown;
+    int aOctaveUp, aOctaveDown, aPlay;
+    int aInstrument[4];
+    int aNote[16];
+
     void loadMedia()
     {
-        mFontImage = loadPNG(mRenderer, "assets/ascii-bnw.png");
+        mFontImage = assets->loadImage("assets/ascii-bnw.png");
+    }
+
+    void bindActions()
+    {
+        aSampleRateUp = actions->addAction("sample rate up");
+        aSampleRateDown = actions->addAction("sample rate down");
+        aVolumeUp = actions->addAction("volume up");
+        aVolumeDown = actions->addAction("volume down");
+        aOctaveUp = actions->addAction("octave up");
+        aOctaveDown = actions->addAction("octave down");
+        aPlay = actions->addAction("play/pause");
+
+        actions->bind(aSampleRateUp, 'q');
+        actions->bind(aSampleRateDown, 'a');
+        actions->bind(aVolumeUp, 'e');
+        actions->bind(aVolumeDown, 'd');
+        actions->bind(aOctaveUp, SDLK_UP);
+        actions->bind(aOctaveDown, SDLK_DOWN);
+        actions->bind(aPlay, SDLK_SPACE);
+
+        for (int k = 0; k < 4; k++)
+        {
+            aInstrument[k] = actions->addAction(wyaudio::getInstrumentName((wyaudio::InstrumentType)k));
+            actions->bind(aInstrument[k], (unsigned char)("1234"[k]));
+        }
+
+        // Piano keys, laid out like a keyboard's white and black keys
+        for (int k = 0; k < 16; k++)
+        {
+            aNote[k] = actions->addAction("note " + std::to_string(k));
+            actions->bind(aNote[k], (unsigned char)("zsxcfvgbnjmk,l./"[k]));
+        }
     }
 
 public:
@@ -200,14 +240,15 @@ public:
         mFont = new WY_MonoFont(mFontImage->texture, 8, 4, {8, 8, 240, 208});
         mFont->setDebug(true);
 
+        // Small buffers so the piano keys respond quickly; see the latency in the HUD
         audio = new GameAudio();
+        audio->init(wyaudio::WY_AudioConfig::lowLatency(256));
+
+        bindActions();
     }
 
     ~Game()
     {
-        SDL_DestroyTexture(mFontImage->texture);
-        delete mFontImage;
-
         delete mFont;
 
         delete audio;
@@ -217,19 +258,19 @@ public:
     {
         // audio settings
 
-        if (keyboard->isKeyPressed('q'))
+        if (actions->isPressed(aSampleRateUp))
         {
             audio->changeSampleRate(1000);
         }
-        else if (keyboard->isKeyPressed('a'))
+        else if (actions->isPressed(aSampleRateDown))
         {
             audio->changeSampleRate(-1000);
         }
-        else if (keyboard->isKeyPressed('e'))
+        else if (actions->isPressed(aVolumeUp))
         {
             audio->changeAmplitude(100);
         }
-        else if (keyboard->isKeyPressed('d'))
+        else if (actions->isPressed(aVolumeDown))
         {
             audio->changeAmplitude(-100);
         }
@@ -238,9 +279,7 @@ public:
 
         for (int k = 0; k < 4; k++)
         {
-            short keyCode = (unsigned char)("1234"[k]);
-
-            if (keyboard->isKeyPressed(keyCode))
+            if (actions->isPressed(aInstrument[k]))
             {
                 audio->setInstrument((wyaudio::InstrumentType)k);
             }
@@ -248,11 +287,11 @@ public:
 
         // music octave
 
-        if (keyboard->isKeyPressed(SDLK_UP))
+        if (actions->isPressed(aOctaveUp))
         {
             audio->increaseOctave();
         }
-        else if (keyboard->isKeyPressed(SDLK_DOWN))
+        else if (actions->isPressed(aOctaveDown))
         {
             audio->decreaseOctave();
         }
@@ -261,19 +300,17 @@ public:
 
         for (int k = 0; k < 16; k++)
         {
-            short keyCode = (unsigned char)("zsxcfvgbnjmk,l./"[k]);
-
-            if (keyboard->isKeyDown(keyCode))
+            if (actions->isDown(aNote[k]))
             {
                 audio->playNote((wyaudio::MusicNote)k, true);
             }
-            else if (keyboard->isKeyUp(keyCode))
+            else
             {
                 audio->playNote((wyaudio::MusicNote)k, false);
             }
         }
 
-        if (keyboard->isKeyPressed(SDLK_SPACE))
+        if (actions->isPressed(aPlay))
         {
             if (audio->isPlaying())
             {
@@ -288,27 +325,25 @@ public:
 
     void onRender()
     {
-        std::string t1 = "Time elapsed        : ";
-        std::string t2 = std::to_string(timer->getTimeSinceStart());
-        std::string t3 = "\n\nfrequency / current sample :\n";
-        std::string t4 = std::to_string(audio->getSampleRate());
-        std::string t4a = " / ";
-        std::string t4b = std::to_string(audio->getDTime());
-        std::string t5 = "\n\nSample size         : ";
-        std::string t6 = std::to_string(audio->getSampleSize());
-        std::string t7 = "\nAmplitude (volume)  : ";
-        std::string t8 = std::to_string(audio->getAmplitude());
-        std::string t9 = "\nChannels (speakers) : ";
-        std::string t10 = std::to_string(audio->getChannelLen());
-
-        std::string s1 = "\n\nInstrument : ";
-        std::string s2 = wyaudio::getInstrumentName(audio->instrument);
-        std::string s3 = "\nNotes      : ";
-        std::string s4 = std::to_string(audio->vecNotes.size());
-        std::string s5 = "\nOctave     : ";
-        std::string s6 = std::to_string(audio->mOctave);
-
-        mFont->print(mRenderer, t1 + t2 + t3 + t4 + t4a + t4b + t5 + t6 + t7 + t8 + t9 + t10 + s1 + s2 + s3 + s4 + s5 + s6);
+        wyaudio::WY_AudioStats stats = audio->getStats();
+
+        mHud.clear()
+            << "Time elapsed        : " << timer->getTimeSinceStart()
+            << "\n\nfrequency / current sample :\n" << audio->getSampleRate() << " / " << audio->getDTime()
+            << "\n\nSample size         : " << audio->getSampleSize()
+            << "\nAmplitude (volume)  : " << audio->getAmplitude()
+            << "\nChannels (speakers) : " << audio->getChannelLen()
+            << "\n\nInstrument : " << wyaudio::getInstrumentName(audio->instrument)
+            << "\nNotes      : " << audio->vecNotes.size()
+            << "\nOctave     : " << audio->mOctave
+            << "\n\nBuffer     : " << audio->getBufferFrames() << " frames\nInterval   : ";
+        mHud.appendFloat(stats.dIntervalMean) << " ms\nJitter     : ";
+        mHud.appendFloat(stats.dJitter) << " ms\nRender     : ";
+        mHud.appendFloat(stats.dRenderMean) << " ms\nUnderruns  : " << stats.nUnderruns << "\nLatency    : ";
+        mHud.appendFloat(audio->getOutputLatency()) << " ms\nPlayback   : ";
+        mHud.appendFloat(audio->getPlaybackTime(), 3) << " s";
+
+        mFont->print(mRenderer, mHud);
     }
 };
 
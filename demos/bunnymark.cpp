@@ -3,6 +3,8 @@
 #include "../src/wyngine.h"
 #include "../src/math.h"
 #include "../src/font.h"
+#include "../src/atlas.h"
+#include "../src/format.h"
 
 #define WIDTH 760
 #define HEIGHT 600
@@ -63,7 +65,6 @@ struct Bunny
 class BunnyMark
 {
 public:
-    WY_Image *imgBunny;
     WY_Sprite srfBunnyTiles;
 
     std::vector<Bunny> vecBunnies;
@@ -75,14 +76,11 @@ public:
 
     ~BunnyMark()
     {
-        SDL_DestroyTexture(imgBunny->texture);
-        delete imgBunny;
-
         // TODO delete each bunny before clearing?
         vecBunnies.clear();
     }
 
-    BunnyMark(SDL_Renderer *renderer, int startBunnyCount)
+    BunnyMark(WY_Sprite bunny, int startBunnyCount)
     {
         frectBounds.x = 0.0;
         frectBounds.h = HEIGHT;
@@ -93,10 +91,7 @@ public:
         nMaxCount = 200000;
         nAmount = 5;
 
-        imgBunny = loadPNG(renderer, "assets/lineup-fixed.png");
-        srfBunnyTiles.renderer = renderer;
-        srfBunnyTiles.texture = imgBunny->texture;
-        srfBunnyTiles.origin = {0, 0, 35, 36};
+        srfBunnyTiles = bunny;
         // srfBunnyTiles.SetTextureFilterMode(false, false);
         // srfBunnyTiles.SetTilesetClipping(12, 1);
         nCount = 0;
@@ -134,6 +129,14 @@ public:
         }
     }
 
+    void Draw(WY_Framebuffer *framebuffer, const WY_Bitmap &bitmap)
+    {
+        for (auto &bunny : vecBunnies)
+        {
+            framebuffer->blit(bitmap, srfBunnyTiles.origin, (int)bunny.dx, (int)bunny.dy, BLIT_COLORKEY);
+        }
+    }
+
     void AddBunnies(int count)
     {
         for (int i = 0; i < count; i++)
@@ -166,30 +169,54 @@ public:
 
 class Game : public Wyngine
 {
-    WY_Image *mFontImage;
+    WY_Atlas mAtlas;
+    WY_Bitmap *mFontBitmap = nullptr;  // software backend only
+    WY_Bitmap *mBunnyBitmap = nullptr; // software backend only
     WY_MonoFont *mFont;
+    WY_TextBlock *mHud;
+    WY_StackString<64> mHudText;
     BunnyMark *bunnymark;
 
     void loadMedia()
     {
-        mFontImage = loadPNG(mRenderer, "assets/ascii-bnw.png");
+        if (framebuffer != nullptr)
+        {
+            mFontBitmap = loadBitmap("assets/ascii-bnw.png");
+            mBunnyBitmap = loadBitmap("assets/lineup-fixed.png");
+            return;
+        }
+
+        // Bunnies and text share one texture, so drawing them needs no texture switch
+        mAtlas.addImage("font", "assets/ascii-bnw.png");
+        mAtlas.addRegion("bunny", "assets/lineup-fixed.png", {0, 0, 35, 36});
+        mAtlas.build(mRenderer);
     }
 
 public:
-    Game() : Wyngine("Wyngine midi demo", WIDTH, HEIGHT, 1)
+    Game(WY_Backend backend) : Wyngine("Wyngine bunnymark", WIDTH, HEIGHT, 1, backend)
     {
         loadMedia();
 
-        mFont = new WY_MonoFont(mFontImage->texture, 8, 4, {8, 8, 240, 208});
-        bunnymark = new BunnyMark(mRenderer, 100);
+        if (framebuffer != nullptr)
+        {
+            mFont = new WY_MonoFont(mFontBitmap, 8, 4, {8, 8, 240, 208});
+            mHud = nullptr;
+            bunnymark = new BunnyMark({mRenderer, NULL, {0, 0, 35, 36}}, 100);
+            return;
+        }
+
+        WY_Sprite font = mAtlas.getSprite("font");
+        mFont = new WY_MonoFont(font.texture, font.origin, 8, 4, {8, 8, 240, 208});
+        mHud = new WY_TextBlock(mFont, {8, 8, 240, 208});
+        bunnymark = new BunnyMark(mAtlas.getSprite("bunny"), 100);
     }
 
     ~Game()
     {
-        SDL_DestroyTexture(mFontImage->texture);
-        delete mFontImage;
-
+        delete mHud;
         delete mFont;
+        delete mFontBitmap;
+        delete mBunnyBitmap;
     }
 
     void onUpdate()
@@ -208,20 +235,59 @@ public:
 
     void onRender()
     {
-        bunnymark->Draw();
+        mHudText.clear()
+            << "Bunnies : " << bunnymark->nCount
+            << "\nFPS : " << timer->getFPS()
+            << (framebuffer != nullptr ? "\nsoftware" : "\nSDL_Renderer");
 
-        std::string t1 = "Bunnies : ";
-        std::string t2 = std::to_string(bunnymark->nCount);
+        if (framebuffer != nullptr)
+        {
+            bunnymark->Draw(framebuffer, *mBunnyBitmap);
+            mFont->print(framebuffer, mHudText);
+            return;
+        }
+
+        bunnymark->Draw();
 
-        mFont->print(mRenderer, t1 + t2);
+        mHud->setText(mHudText);
+        mHud->draw(mRenderer);
     }
 };
 
+// Run with --software to benchmark the software renderer against SDL_Renderer.
+// --record <file> saves the session's input; --replay <file> plays it back
+// (add --headless to run it hidden and uncapped), for comparing builds.
 int main(int argc, char *args[])
 {
-    Game *game = new Game();
+    WY_Backend backend = BACKEND_SDL;
+    WY_InputLog inputLog;
+    bool bHeadless = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(args[i], "--software") == 0)
+        {
+            backend = BACKEND_SOFTWARE;
+        }
+        else if (strcmp(args[i], "--headless") == 0)
+        {
+            bHeadless = true;
+        }
+        else if (strcmp(args[i], "--record") == 0 && i + 1 < argc)
+        {
+            inputLog.record(args[++i]);
+        }
+        else if (strcmp(args[i], "--replay") == 0 && i + 1 < argc)
+        {
+            inputLog.replay(args[++i]);
+        }
+    }
+
+    // After the log is opened, so the bunnies roll the same random numbers
+    Game *game = new Game(backend);
+    game->setInputLog(&inputLog, bHeadless);
 
     game->run();
 
     return 0;
-}
\ No newline at end of file
+}
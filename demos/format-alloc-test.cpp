@@ -0,0 +1,97 @@
+// Checks that per-frame HUD formatting with WY_StackString never touches the
+// heap: every operator new is counted while building a few thousand frames of
+// HUD text like the demos do. Run with `mingw32-make format-alloc-test`.
+
+#define SDL_MAIN_HANDLED
+#include <SDL2/SDL.h>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string_view>
+
+#include "../src/format.h"
+
+#define FRAMES 10000
+
+static size_t nAllocations = 0;
+
+void *operator new(size_t size)
+{
+    nAllocations++;
+    void *p = malloc(size ? size : 1);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+int main(int argc, char *args[])
+{
+    WY_StackString<1024> hud;
+    WY_StackString<32> small;
+    std::string_view name = "Overworld (Super Mario Bros.)";
+    size_t total = 0;
+
+    size_t before = nAllocations;
+
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        double time = frame / 60.0;
+
+        hud.clear()
+            << "Bunnies : " << frame * 100
+            << "\nFPS : " << 60 - frame % 3
+            << "\nTime : " << time
+            << "\nFile : " << name
+            << "\nMuted : " << (frame % 2 == 0)
+            << "\nKey : " << (char)('a' + frame % 26)
+            << "\nSamples : " << (Uint64)frame * 44100
+            << "\nLatency : ";
+        hud.appendFloat(time * 0.37, 3) << " ms\nOffset : ";
+        hud.appendInt(-frame, 6, '0') << "\nFixed : ";
+        hud.appendFixed(frame * 125, 3);
+
+        // Overflowing a small one only truncates
+        small.clear() << name << name << frame;
+
+        total += hud.view().size() + small.view().size();
+    }
+
+    size_t count = nAllocations - before;
+    printf("%d frames, %zu chars formatted, %zu allocations\n", FRAMES, total, count);
+
+    if (count != 0 || !small.isTruncated())
+    {
+        printf("FAILED\n");
+        return 1;
+    }
+
+    printf("OK\n");
+    return 0;
+}
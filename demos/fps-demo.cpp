@@ -1,14 +1,16 @@
 #include "../src/wyngine.h"
 #include "../src/font.h"
+#include "../src/format.h"
 
 class Game : public Wyngine
 {
-    WY_Image *mFontImage;
+    WY_ImageHandle mFontImage;
     WY_MonoFont *mFont;
+    WY_StackString<256> mHud;
 
     void loadMedia()
     {
-        mFontImage = loadPNG(mRenderer, "assets/ascii-bnw.png");
+        mFontImage = assets->loadImage("assets/ascii-bnw.png");
     }
 
 public:
@@ -21,32 +23,32 @@ public:
 
     void onUpdate()
     {
-        if (windowEvent.type == SDL_KEYDOWN)
+        for (const SDL_Event &event : *events)
         {
-            switch (windowEvent.key.keysym.sym)
+            if (event.type == SDL_KEYDOWN)
             {
-            case SDLK_ESCAPE:
-                mGameRunning = false;
-                break;
-
-            case SDLK_RETURN:
-                timer->reset();
+                switch (event.key.keysym.sym)
+                {
+                case SDLK_ESCAPE:
+                    mGameRunning = false;
+                    break;
+
+                case SDLK_RETURN:
+                    timer->reset();
+                }
             }
         }
     }
 
     void onRender()
     {
-        std::string txt1 = "Time since start : ";
-        std::string txt2 = std::to_string(timer->getStartTime());
-        std::string txt3 = "\nFrames : ";
-        std::string txt4 = std::to_string(timer->getFrames());
-        std::string txt5 = "\ndTime : ";
-        std::string txt6 = std::to_string(timer->getDeltaTime());
-        std::string txt7 = "\nFPS : ";
-        std::string txt8 = std::to_string(timer->getFPS());
-        std::string txt9 = "\n\nPress enter to reset";
-        mFont->print(mRenderer, txt1 + txt2 + txt3 + txt4 + txt5 + txt6 + txt7 + txt8 + txt9);
+        mHud.clear()
+            << "Time since start : " << timer->getStartTime()
+            << "\nFrames : " << timer->getFrames()
+            << "\ndTime : " << timer->getDeltaTime()
+            << "\nFPS : " << timer->getFPS()
+            << "\n\nPress enter to reset";
+        mFont->print(mRenderer, mHud);
     }
 };
 
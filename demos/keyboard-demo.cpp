@@ -1,14 +1,17 @@
 #include "../src/wyngine.h"
 #include "../src/font.h"
+#include "../src/format.h"
 
 class Game : public Wyngine
 {
-    WY_Image *mFontImage;
+    WY_ImageHandle mFontImage;
     WY_MonoFont *mFont;
+    WY_StackString<512> mHud;
+    WY_StackString<512> mLastHud;
 
     void loadMedia()
     {
-        mFontImage = loadPNG(mRenderer, "assets/ascii-bnw.png");
+        mFontImage = assets->loadImage("assets/ascii-bnw.png");
     }
 
 public:
@@ -18,41 +21,52 @@ public:
 
         mFont = new WY_MonoFont(mFontImage->texture, 8, 4, {8, 8, 240, 50});
         mFont->setDebug(true);
+
+        // The screen only changes on input, so skip redrawing and presenting otherwise
+        setRetainedMode(true);
     }
 
     void onUpdate()
     {
-        if (windowEvent.type == SDL_KEYDOWN)
+        for (const SDL_Event &event : *events)
         {
-            switch (windowEvent.key.keysym.sym)
+            if (event.type == SDL_KEYDOWN)
             {
-            case SDLK_ESCAPE:
-                mGameRunning = false;
-                break;
+                switch (event.key.keysym.sym)
+                {
+                case SDLK_ESCAPE:
+                    mGameRunning = false;
+                    break;
+                }
             }
         }
-    }
 
-    void onRender()
-    {
-        std::string t1 = "char pressed: ";
-        char t2 = keyboard->getLastCharPressed();
-        std::string t3 = "\nkeycode     : ";
-        std::string t4 = std::to_string(keyboard->getLastCharPressed());
+        // Views into the text buffer, not copies, and the text isn't moved
+        // to make them (unlike getText())
+        int cursor = io->getCursor();
+        WY_TextSpans before = io->getTextSpans(0, cursor);
+        WY_TextSpans after = io->getTextSpans(cursor);
 
-        std::string t5 = "\n\nEntered text: ";
-        std::string t6 = io->getText();
+        mHud.clear()
+            << "char pressed: " << (char)keyboard->getLastCharPressed()
+            << "\nkeycode     : " << (int)keyboard->getLastCharPressed()
+            << "\n\nEntered text: " << before.first << before.second << io->getComposition() << "_" << after.first << after.second
+            << "\n\n5 pressed?  : " << keyboard->isKeyPressed(SDLK_5)
+            << "\n5 release?  : " << keyboard->isKeyReleased(SDLK_5)
+            << "\n5 up?       : " << keyboard->isKeyUp(SDLK_5)
+            << "\n5 down?     : " << keyboard->isKeyDown(SDLK_5)
+            << "\n\nEvents max  : " << getEventStats().nMaxEvents;
 
-        std::string t7 = "\n\n5 pressed?  : ";
-        std::string t8 = std::to_string(keyboard->isKeyPressed(SDLK_5));
-        std::string t9 = "\n5 release?  : ";
-        std::string t10 = std::to_string(keyboard->isKeyReleased(SDLK_5));
-        std::string t11 = "\n5 up?       : ";
-        std::string t12 = std::to_string(keyboard->isKeyUp(SDLK_5));
-        std::string t13 = "\n5 down?     : ";
-        std::string t14 = std::to_string(keyboard->isKeyDown(SDLK_5));
+        if (mHud.view() != mLastHud.view())
+        {
+            mLastHud.clear() << mHud.view();
+            markDirty({8, 8, 240, mGameH - 8});
+        }
+    }
 
-        mFont->print(mRenderer, t1 + t2 + t3 + t4 + t5 + t6 + t7 + t8 + t9 + t10 + t11 + t12 + t13 + t14);
+    void onRender()
+    {
+        mFont->print(mRenderer, mHud);
     }
 };
 
@@ -0,0 +1,115 @@
+// Converts a .mid file into the baked song format (see src/audio/song.h)
+//
+// Usage: midi-bake <input.mid> <output.wysong> [instrument for track 0] [track 1] ...
+//
+// Tracks without an explicit instrument are assigned their own track index,
+// which is what midi-demo used to do when playing .mid files directly.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+
+#include "../src/audio/midi.h"
+#include "../src/audio/song.h"
+
+using namespace wyaudio;
+
+bool bakeSong(WY_MidiFile &midi, const char *file, std::vector<int> &instruments)
+{
+    std::vector<WY_SongTempo> tempos;
+    std::vector<WY_SongTrack> tracks;
+    std::vector<WY_SongNote> notes;
+    Uint32 nLength = 0;
+
+    // Same tick -> ms conversion that WY_MidiFile uses for note times
+    double dMsPerTick = 60000.0 / ((double)midi.getBPM() * (double)midi.nTickDiv);
+
+    for (auto &t : midi.vecTempos)
+    {
+        tempos.push_back({t.nTick, (Uint32)(dMsPerTick * t.nTick), t.nTempo});
+    }
+    if (tempos.empty())
+    {
+        tempos.push_back({0, 0, 500000}); // 120bpm
+    }
+    std::stable_sort(tempos.begin(), tempos.end(), [](const WY_SongTempo &a, const WY_SongTempo &b) { return a.nTick < b.nTick; });
+
+    for (size_t i = 0; i < midi.vecTracks.size(); i++)
+    {
+        auto &vecNotes = midi.vecTracks[i].vecNotes;
+
+        WY_SongTrack track{};
+        track.nFirstNote = notes.size();
+        track.nNoteCount = vecNotes.size();
+        track.nInstrument = i < instruments.size() ? instruments[i] : i;
+        tracks.push_back(track);
+
+        for (auto &n : vecNotes)
+        {
+            WY_SongNote note{};
+            note.nStartTime = n.nStartTime;
+            note.nDuration = n.nDuration;
+            note.nKey = n.nKey;
+            note.nVelocity = n.nVelocity;
+            notes.push_back(note);
+
+            nLength = std::max(nLength, n.nStartTime + n.nDuration);
+        }
+
+        // WY_MidiFile stores notes in note-off order; the player expects start order
+        std::stable_sort(notes.begin() + track.nFirstNote, notes.end(), [](const WY_SongNote &a, const WY_SongNote &b) { return a.nStartTime < b.nStartTime; });
+    }
+
+    WY_SongHeader header{};
+    header.nMagic = WY_SONG_MAGIC;
+    header.nVersion = WY_SONG_VERSION;
+    header.nTickDiv = midi.nTickDiv;
+    header.nLength = nLength;
+    header.nTempoCount = tempos.size();
+    header.nTempoOffset = sizeof(WY_SongHeader);
+    header.nTrackCount = tracks.size();
+    header.nTrackOffset = header.nTempoOffset + tempos.size() * sizeof(WY_SongTempo);
+    header.nNoteCount = notes.size();
+    header.nNoteOffset = header.nTrackOffset + tracks.size() * sizeof(WY_SongTrack);
+
+    std::ofstream ofs;
+    ofs.open(file, std::fstream::out | std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open())
+    {
+        printf("\nFailed to open file: %s\n", file);
+        return false;
+    }
+
+    ofs.write((const char *)&header, sizeof(header));
+    ofs.write((const char *)tempos.data(), tempos.size() * sizeof(WY_SongTempo));
+    ofs.write((const char *)tracks.data(), tracks.size() * sizeof(WY_SongTrack));
+    ofs.write((const char *)notes.data(), notes.size() * sizeof(WY_SongNote));
+
+    printf("\nBaked %d tracks, %d notes, %d tempo changes into %s\n", (int)tracks.size(), (int)notes.size(), (int)tempos.size(), file);
+
+    return ofs.good();
+}
+
+int main(int argc, char *args[])
+{
+    if (argc < 3)
+    {
+        printf("Usage: %s <input.mid> <output.wysong> [instrument per track...]\n", args[0]);
+        return 1;
+    }
+
+    WY_MidiFile midi;
+    if (!midi.loadFile(args[1]))
+    {
+        return 1;
+    }
+
+    std::vector<int> instruments;
+    for (int i = 3; i < argc; i++)
+    {
+        instruments.push_back(atoi(args[i]));
+    }
+
+    return bakeSong(midi, args[2], instruments) ? 0 : 1;
+}
@@ -2,12 +2,14 @@
 
 #include "../src/wyngine.h"
 #include "../src/font.h"
+#include "../src/format.h"
 #include "../src/audio/midi.h"
+#include "../src/audio/song.h"
 
 struct PlayNote
 {
-    wyaudio::WY_MidiNote note;
-    int channel = 0;
+    wyaudio::WY_SongNote note;
+    Uint32 handle = 0;        // voice from noteOn
     Uint32 playStartTime = 0; // start time (absolute)
 };
 
@@ -16,7 +18,9 @@ class GameAudio : public wyaudio::WY_MidiPlayer
     Uint32 dStartTime;
     Uint32 dCurrTime;
 
-    wyaudio::WY_MidiFile *midi;
+    // Pre-baked with midi-bake from the .mid files in assets/
+    wyaudio::WY_BakedSong songs[3];
+    wyaudio::WY_BakedSong *midi;
     int currMidiIndex = 0;
     int trackLen;
     int *noteIndices;
@@ -40,31 +44,21 @@ public:
     {
         midi = NULL;
 
-        wyaudio::WY_MidiFile *midi1 = new wyaudio::WY_MidiFile("assets/overworld-smb.mid");
-        wyaudio::WY_MidiFile *midi2 = new wyaudio::WY_MidiFile("assets/overworld-zelda.mid");
-        wyaudio::WY_MidiFile *midi3 = new wyaudio::WY_MidiFile("assets/pallet-town.mid");
-
-        midiFiles.push_back(midi1);
-        midiFiles.push_back(midi2);
-        midiFiles.push_back(midi3);
+        songs[0].load("assets/overworld-smb.wysong");
+        songs[1].load("assets/overworld-zelda.wysong");
+        songs[2].load("assets/pallet-town.wysong");
     }
 
     ~GameAudio()
     {
         midi = NULL;
 
-        for (auto &m : midiFiles)
-        {
-            delete m;
-        }
-        midiFiles.clear();
-
         delete noteIndices;
 
         SDL_DestroyMutex(muxNotes);
     }
 
-    std::string getSongName()
+    const char *getSongName()
     {
         switch (currMidiIndex)
         {
@@ -82,9 +76,9 @@ public:
     void playMidi(int index)
     {
         currMidiIndex = index;
-        midi = midiFiles.at(index);
+        midi = &songs[index];
 
-        trackLen = midi->vecTracks.size();
+        trackLen = midi->getTrackCount();
         noteIndices = new int[trackLen];
         completedTracks = new int[trackLen];
         for (int i = 0; i < trackLen; i++)
@@ -97,53 +91,13 @@ public:
         dStartTime = SDL_GetTicks();
     }
 
-    void playNote(wyaudio::WY_MidiNote k, int channel)
+    // Track instruments 1-4 play on mixer channels 0-3, anything else on channel 0
+    void playNote(wyaudio::WY_SongNote k, int instrument)
     {
-        if (SDL_LockMutex(muxNotes) != 0)
-            return;
-
-        activeNotes.push_back({k, channel, SDL_GetTicks()});
+        int channel = instrument >= 1 && instrument <= 4 ? instrument - 1 : 0;
+        Uint32 handle = noteOn(k.nKey, channel);
 
-        SDL_UnlockMutex(muxNotes);
-    }
-
-    double getAudioSample()
-    {
-        if (SDL_LockMutex(muxNotes) != 0)
-            return 0.0;
-
-        double dMixedOutput = 0.0;
-
-        for (auto &n : activeNotes)
-        {
-            bool bNoteFinished = false;
-            double dSound = 0.0;
-
-            switch (n.channel)
-            {
-            case 1:
-                dSound = chan0.speak2(getDTime(), n.note.nKey);
-                break;
-            case 2:
-                dSound = chan1.speak2(getDTime(), n.note.nKey);
-                break;
-            case 3:
-                dSound = chan2.speak2(getDTime(), n.note.nKey);
-                break;
-            case 4:
-                dSound = chan3.speak2(getDTime(), n.note.nKey);
-                break;
-            default:
-                dSound = chan0.speak2(getDTime(), n.note.nKey);
-                break;
-            }
-
-            dMixedOutput += dSound;
-        }
-
-        SDL_UnlockMutex(muxNotes);
-
-        return dMixedOutput;
+        activeNotes.push_back({k, handle, SDL_GetTicks()});
     }
 
     void reset(bool play = false)
@@ -176,6 +130,7 @@ public:
         {
             if (SDL_GetTicks() >= n->playStartTime + n->note.nDuration)
             {
+                noteOff(n->handle);
                 n = activeNotes.erase(n);
             }
             else
@@ -195,21 +150,21 @@ public:
                     break;
                 }
 
-                auto &track = midi->vecTracks.at(i);
-                auto &notes = track.vecNotes;
-                if (noteIndices[i] >= notes.size())
+                auto &track = midi->getTrack(i);
+                auto *notes = midi->getNotes(i);
+                if (noteIndices[i] >= track.nNoteCount)
                 {
                     // skip track if all notes are played
                     completedTracks[i] = 1;
                     continue;
                 }
 
-                auto &note = notes.at(noteIndices[i]);
+                auto &note = notes[noteIndices[i]];
 
                 if (dCurrTime >= note.nStartTime)
                 {
                     // add this note to currently played notes
-                    playNote(note, i);
+                    playNote(note, track.nInstrument);
 
                     // track next note
                     noteIndices[i] += 1;
@@ -231,13 +186,42 @@ public:
 
 class Game : public Wyngine
 {
-    WY_Image *mFontImage;
+    WY_ImageHandle mFontImage;
     WY_MonoFont *mFont;
+    WY_StackString<256> mHud;
     GameAudio *audio;
 
+    int aReset;
+    int aSong[3];
+    int aMute[4];
+    int aThreads;
+
     void loadMedia()
     {
-        mFontImage = loadPNG(mRenderer, "assets/ascii-bnw.png");
+        mFontImage = assets->loadImage("assets/ascii-bnw.png");
+    }
+
+    void bindActions()
+    {
+        aReset = actions->addAction("reset");
+        actions->bind(aReset, SDLK_SPACE);
+
+        for (int k = 0; k < 3; k++)
+        {
+            std::string name = "song " + std::to_string(k + 1);
+            aSong[k] = actions->addAction(name);
+            actions->bind(aSong[k], (unsigned char)("123"[k]));
+        }
+
+        // Mute the mixer channels (pulse 1, pulse 2, wave, noise)
+        for (int k = 0; k < 4; k++)
+        {
+            aMute[k] = actions->addAction("mute " + std::to_string(k + 1));
+            actions->bind(aMute[k], (unsigned char)("qwer"[k]));
+        }
+
+        aThreads = actions->addAction("voice threads");
+        actions->bind(aThreads, 't');
     }
 
 public:
@@ -250,13 +234,12 @@ public:
 
         audio = new GameAudio();
         audio->init();
+
+        bindActions();
     }
 
     ~Game()
     {
-        SDL_DestroyTexture(mFontImage->texture);
-        delete mFontImage;
-
         delete mFont;
 
         delete audio;
@@ -266,33 +249,51 @@ public:
     {
         audio->update();
 
-        if (keyboard->isKeyPressed(SDLK_SPACE))
+        if (actions->isPressed(aReset))
         {
             audio->reset();
         }
 
         for (int k = 0; k < 3; k++)
         {
-            short keyCode = (unsigned char)("123"[k]);
-
-            if (keyboard->isKeyPressed(keyCode))
+            if (actions->isPressed(aSong[k]))
             {
                 audio->playMidi(k);
                 audio->play();
             }
         }
+
+        for (int k = 0; k < 4; k++)
+        {
+            if (actions->isPressed(aMute[k]))
+            {
+                audio->setChannelMute(k, !audio->isChannelMuted(k));
+            }
+        }
+
+        if (actions->isPressed(aThreads))
+        {
+            audio->setVoiceThreads(audio->getVoiceThreads() > 0 ? 0 : 2);
+        }
     }
 
     void onRender()
     {
-        std::string t1 = "Game dTime : ";
-        std::string t2 = std::to_string(timer->getTimeSinceStart());
-        std::string t3 = "\nAudio dTime : ";
-        std::string t4 = std::to_string(audio->getDTime());
-        std::string t5 = "\nFile : ";
-        std::string t6 = audio->getSongName();
-
-        mFont->print(mRenderer, t1 + t2 + t3 + t4 + t5 + t6);
+        mHud.clear()
+            << "Game dTime : " << timer->getTimeSinceStart()
+            << "\nAudio dTime : " << audio->getDTime()
+            << "\nFile : " << audio->getSongName()
+            << "\nChannels (Q/W/E/R) :";
+
+        for (int k = 0; k < 4; k++)
+        {
+            mHud << ' ' << (audio->isChannelMuted(k) ? '-' : (char)('1' + k));
+        }
+
+        mHud << "\nVoices : " << audio->getVoiceCount()
+             << "\nVoice threads (T) : " << audio->getVoiceThreads();
+
+        mFont->print(mRenderer, mHud);
     }
 };
 
@@ -20,13 +20,16 @@ public:
 
     void onUpdate()
     {
-        if (windowEvent.type == SDL_KEYDOWN)
+        for (const SDL_Event &event : *events)
         {
-            switch (windowEvent.key.keysym.sym)
+            if (event.type == SDL_KEYDOWN)
             {
-            case SDLK_ESCAPE:
-                mGameRunning = false;
-                break;
+                switch (event.key.keysym.sym)
+                {
+                case SDLK_ESCAPE:
+                    mGameRunning = false;
+                    break;
+                }
             }
         }
     }
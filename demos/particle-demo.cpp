@@ -0,0 +1,96 @@
+#include <SDL2/SDL.h>
+
+#include "../src/wyngine.h"
+#include "../src/math.h"
+#include "../src/font.h"
+#include "../src/format.h"
+#include "../src/particles.h"
+
+#define WIDTH 760
+#define HEIGHT 600
+#define MAX_PARTICLES 150000
+
+// Particle version of bunnymark: hold space to add fountains, R to remove
+// them all. Each fountain keeps about 10k particles alive.
+class Game : public Wyngine
+{
+    WY_ImageHandle mFontImage;
+    WY_MonoFont *mFont;
+    WY_StackString<128> mHudText;
+    WY_ParticleSystem mParticles{MAX_PARTICLES};
+    int nFountains = 0;
+
+    void addFountain()
+    {
+        WY_Emitter fountain;
+        fountain.area = {wyrandom<int>(WIDTH - 100) + 50.0f, (float)HEIGHT, 8.0f, 0.0f};
+        fountain.fRate = 5000.0f;
+        fountain.fLifeMin = 1.5f;
+        fountain.fLifeMax = 2.5f;
+        fountain.fVelXMin = -60.0f;
+        fountain.fVelXMax = 60.0f;
+        fountain.fVelYMin = -520.0f;
+        fountain.fVelYMax = -380.0f;
+        fountain.fGravity = 300.0f;
+        fountain.fSize = 3.0f;
+        fountain.colorStart = {wyrandom<Uint8>(256), wyrandom<Uint8>(256), 0xFF, 0xFF};
+        fountain.colorEnd = {0xFF, 0xFF, 0xFF, 0x00};
+
+        mParticles.addEmitter(fountain);
+        nFountains++;
+    }
+
+public:
+    Game() : Wyngine("Wyngine particles", WIDTH, HEIGHT, 1)
+    {
+        mFontImage = assets->loadImage("assets/ascii-bnw.png");
+        mFont = new WY_MonoFont(mFontImage->texture, 8, 4, {8, 8, 240, 208});
+
+        addFountain();
+    }
+
+    ~Game()
+    {
+        delete mFont;
+    }
+
+    void onUpdate()
+    {
+        if (keyboard->isKeyDown(SDLK_SPACE) && timer->getFrames() % 10 == 0)
+        {
+            addFountain();
+        }
+
+        if (keyboard->isKeyPressed(SDLK_r))
+        {
+            mParticles.reset();
+            nFountains = 0;
+        }
+
+        // Fixed step, so a slow frame doesn't fling particles
+        mParticles.update(1.0f / timer->getFPSLimit());
+    }
+
+    void onRender()
+    {
+        mParticles.draw(mRenderer);
+
+        const WY_ParticleStats &stats = mParticles.getStats();
+        mHudText.clear()
+            << "Particles : " << stats.nAlive
+            << "\nFountains : " << nFountains
+            << "\nDropped : " << stats.nDropped
+            << "\nFPS : " << timer->getFPS();
+
+        mFont->print(mRenderer, mHudText.view());
+    }
+};
+
+int main(int argc, char *args[])
+{
+    Game *game = new Game();
+
+    game->run();
+
+    return 0;
+}
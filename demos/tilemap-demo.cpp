@@ -0,0 +1,185 @@
+#include <SDL2/SDL.h>
+
+#include "../src/wyngine.h"
+#include "../src/math.h"
+#include "../src/font.h"
+#include "../src/atlas.h"
+#include "../src/format.h"
+#include "../src/tilemap.h"
+#include "../src/spatial.h"
+
+#define WIDTH 320
+#define HEIGHT 240
+#define MAP_SIZE 1000
+#define TILE_SIZE 8
+#define CRITTERS 100000
+
+// ascii-bnw.png is mini-ascii: its first glyph is ' ', 16 to a row
+static Uint16 glyph(char c)
+{
+    return c - ' ';
+}
+
+struct Critter
+{
+    SDL_Rect rect;
+    int dx, dy;
+    int nCell; // id in the spatial hash
+};
+
+// Scroll a 1000x1000 map made of font glyphs with the arrow keys (hold shift
+// to go faster) and zoom with Z/X. Only the chunks and critters on screen are
+// drawn, so the frame time stays the same wherever the camera is.
+class Game : public Wyngine
+{
+    WY_Atlas mAtlas;
+    WY_MonoFont *mFont;
+    WY_Tilemap *mMap;
+    WY_Sprite mCritterSprite;
+    std::vector<Critter> mCritters;
+    WY_SpatialHash mCritterCells{32, 65536}; // one bucket per cell of the 8000x8000 world
+    std::vector<int> mVisible;
+    WY_StackString<224> mHudText;
+
+    void generateMap()
+    {
+        const char tiles[] = "..,,''\"\"~~^#";
+
+        for (int y = 0; y < MAP_SIZE; y++)
+        {
+            for (int x = 0; x < MAP_SIZE; x++)
+            {
+                // Mostly empty, with the odd wall to show chunk edges don't matter
+                if (x % 50 == 0 || y % 50 == 0)
+                {
+                    mMap->setTile(x, y, glyph('#'));
+                }
+                else if (wyrandom<int>(4) == 0)
+                {
+                    mMap->setTile(x, y, glyph(tiles[wyrandom<int>(sizeof(tiles) - 1)]));
+                }
+            }
+        }
+    }
+
+    void spawnCritters()
+    {
+        mCritters.resize(CRITTERS);
+        for (auto &critter : mCritters)
+        {
+            critter.rect = {wyrandom<int>(MAP_SIZE * TILE_SIZE), wyrandom<int>(MAP_SIZE * TILE_SIZE), TILE_SIZE, TILE_SIZE};
+            critter.dx = wyrandom<int>(3) - 1;
+            critter.dy = wyrandom<int>(3) - 1;
+            critter.nCell = mCritterCells.insert(critter.rect);
+        }
+    }
+
+public:
+    Game() : Wyngine("Wyngine tilemap", WIDTH, HEIGHT, 2)
+    {
+        mAtlas.addImage("font", "assets/ascii-bnw.png");
+        mAtlas.build(mRenderer);
+
+        WY_Sprite font = mAtlas.getSprite("font");
+        mFont = new WY_MonoFont(font.texture, font.origin, 8, 4, {8, 8, 240, 208});
+        mMap = new WY_Tilemap(MAP_SIZE, MAP_SIZE, TILE_SIZE, font);
+
+        mCritterSprite = font;
+        int cols = font.origin.w / TILE_SIZE;
+        mCritterSprite.origin = {font.origin.x + (glyph('@') % cols) * TILE_SIZE, font.origin.y + (glyph('@') / cols) * TILE_SIZE, TILE_SIZE, TILE_SIZE};
+
+        generateMap();
+        spawnCritters();
+    }
+
+    ~Game()
+    {
+        delete mMap;
+        delete mFont;
+    }
+
+    void onUpdate()
+    {
+        double speed = (keyboard->isKeyDown(SDLK_LSHIFT) ? 16.0 : 4.0) / camera->getZoom();
+
+        if (keyboard->isKeyDown(SDLK_LEFT))
+        {
+            camera->move(-speed, 0);
+        }
+        if (keyboard->isKeyDown(SDLK_RIGHT))
+        {
+            camera->move(speed, 0);
+        }
+        if (keyboard->isKeyDown(SDLK_UP))
+        {
+            camera->move(0, -speed);
+        }
+        if (keyboard->isKeyDown(SDLK_DOWN))
+        {
+            camera->move(0, speed);
+        }
+        if (keyboard->isKeyPressed(SDLK_z))
+        {
+            camera->setZoom(std::min(camera->getZoom() * 2.0, 4.0));
+        }
+        if (keyboard->isKeyPressed(SDLK_x))
+        {
+            camera->setZoom(std::max(camera->getZoom() / 2.0, 0.25));
+        }
+
+        // Editing a tile only re-bakes its own chunk
+        if (keyboard->isKeyPressed(SDLK_SPACE))
+        {
+            SDL_Point center = camera->toWorld(WIDTH / 2, HEIGHT / 2);
+            int x = center.x / TILE_SIZE;
+            int y = center.y / TILE_SIZE;
+            mMap->setTile(x, y, mMap->getTile(x, y) == glyph('%') ? WY_TILE_EMPTY : glyph('%'));
+        }
+
+        // Most moves stay in the same cell and only update the rect
+        for (auto &critter : mCritters)
+        {
+            critter.rect.x = std::min(std::max(critter.rect.x + critter.dx, 0), MAP_SIZE * TILE_SIZE - TILE_SIZE);
+            critter.rect.y = std::min(std::max(critter.rect.y + critter.dy, 0), MAP_SIZE * TILE_SIZE - TILE_SIZE);
+            mCritterCells.move(critter.nCell, critter.rect);
+        }
+    }
+
+    void onRender()
+    {
+        mMap->draw(mRenderer, camera);
+
+        // The hash hands back critter ids, which are indices into mCritters
+        mCritterCells.query(camera->getView(), mVisible);
+        for (int id : mVisible)
+        {
+            queue->draw(mCritterSprite, camera->toScreen(mCritters[id].rect), 1, mCritters[id].rect.y);
+        }
+        flushQueue(); // critters under the HUD
+
+        const WY_TilemapStats &mapStats = mMap->getStats();
+        const WY_SpatialStats &critterStats = mCritterCells.getStats();
+        const WY_RenderQueueStats &queueStats = queue->getStats();
+        mHudText.clear()
+            << "FPS : " << timer->getFPS()
+            << "\nCamera : " << (int)camera->getX() << ", " << (int)camera->getY() << " " << (int)(camera->getZoom() * 100) << "%"
+            << "\nChunks : " << mapStats.nChunksDrawn << "/" << mapStats.nChunksVisited
+            << "\nBaked : " << mapStats.nChunksBaked << " Textures : " << mapStats.nTexturesResident
+            << "\nCritters : " << critterStats.nItemsFound << "/" << critterStats.nItemsVisited << "/" << CRITTERS
+            << "\nBatches : " << queueStats.nBatches;
+
+        SDL_SetRenderDrawColor(mRenderer, 0x00, 0x00, 0x00, 0xFF);
+        SDL_Rect hud = {4, 4, 248, 64};
+        SDL_RenderFillRect(mRenderer, &hud);
+        mFont->print(mRenderer, mHudText.view());
+    }
+};
+
+int main(int argc, char *args[])
+{
+    Game *game = new Game();
+
+    game->run();
+
+    return 0;
+}
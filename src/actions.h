@@ -0,0 +1,340 @@
+// Input actions
+//
+// Maps named actions ("jump", "pause", ...) to keys, so game code asks
+// actions->isPressed(jump) instead of checking raw keys. An action can have
+// any number of bindings, and a binding can be a chord of up to
+// WY_CHORD_KEYS keys that must all be held (e.g. Left Ctrl + S).
+//
+//   int save = actions->addAction("save");
+//   actions->bind(save, SDLK_F5);
+//   actions->bind(save, {SDLK_LCTRL, SDLK_s});
+//
+// Bindings are compiled into flat tables indexed by scancode: the actions
+// each single key triggers (as a bitset), and the chords each key completes.
+// update() then only visits the keys that are held, so a frame costs the same
+// however many bindings a game defines. The result is a bitset of actions
+// that are down, plus their pressed/released edges.
+//
+// Keycode bindings follow the keyboard layout; the tables are rebuilt when it
+// changes.
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "events.h"
+#include "keyboard.h"
+
+#define WY_MAX_ACTIONS 64
+#define WY_CHORD_KEYS 4
+
+class WY_ActionMap
+{
+    struct Binding
+    {
+        int action;
+        int nKeys;
+        SDL_Keycode keys[WY_CHORD_KEYS];
+        bool bScancode; // keys are scancodes, not keycodes
+    };
+
+    struct Chord
+    {
+        Uint64 mask;
+        int nKeys;
+        SDL_Scancode keys[WY_CHORD_KEYS];
+    };
+
+    static bool getBit(Uint64 bits, int action)
+    {
+        return action >= 0 && action < WY_MAX_ACTIONS && ((bits >> action) & 1);
+    }
+
+    std::vector<std::string> mNames;
+    std::vector<Binding> mBindings;
+    bool bDirty = true;
+
+    // Compiled tables
+    Uint64 mKeyActions[SDL_NUM_SCANCODES];     // actions each key triggers on its own
+    Uint16 mChordStart[SDL_NUM_SCANCODES + 1]; // chords completed by key k: mChords[mChordStart[k]..mChordStart[k + 1])
+    std::vector<Chord> mChords;
+
+    Uint64 mDown = 0;
+    Uint64 mPrevDown = 0;
+
+    SDL_Scancode toScancode(const Binding &binding, int i)
+    {
+        return binding.bScancode ? (SDL_Scancode)binding.keys[i] : SDL_GetScancodeFromKey(binding.keys[i]);
+    }
+
+    void compile()
+    {
+        memset(mKeyActions, 0, sizeof(mKeyActions));
+        memset(mChordStart, 0, sizeof(mChordStart));
+        mChords.clear();
+
+        // Chords are keyed by their last key, usually the one that isn't a modifier
+        std::vector<int> trigger;
+        for (const Binding &binding : mBindings)
+        {
+            SDL_Scancode last = toScancode(binding, binding.nKeys - 1);
+            if (last == SDL_SCANCODE_UNKNOWN || last >= SDL_NUM_SCANCODES)
+            {
+                continue;
+            }
+
+            if (binding.nKeys == 1)
+            {
+                mKeyActions[last] |= (Uint64)1 << binding.action;
+                continue;
+            }
+
+            Chord chord = {(Uint64)1 << binding.action, binding.nKeys - 1, {}};
+            for (int i = 0; i < chord.nKeys; i++)
+            {
+                chord.keys[i] = toScancode(binding, i);
+            }
+            mChords.push_back(chord);
+            trigger.push_back(last);
+            mChordStart[last + 1]++;
+        }
+
+        // Counts to offsets, then order the chords by trigger key
+        for (int k = 0; k < SDL_NUM_SCANCODES; k++)
+        {
+            mChordStart[k + 1] += mChordStart[k];
+        }
+
+        std::vector<Chord> sorted(mChords.size());
+        std::vector<Uint16> next(mChordStart, mChordStart + SDL_NUM_SCANCODES);
+        for (size_t i = 0; i < mChords.size(); i++)
+        {
+            sorted[next[trigger[i]]++] = mChords[i];
+        }
+        mChords.swap(sorted);
+
+        bDirty = false;
+    }
+
+    template <class Keys>
+    bool addBinding(int action, const Keys &keys, bool bScancode)
+    {
+        if (action < 0 || action >= (int)mNames.size())
+        {
+            SDL_Log("Unable to bind unknown action %d!\n", action);
+            return false;
+        }
+
+        if (keys.size() == 0 || keys.size() > WY_CHORD_KEYS)
+        {
+            SDL_Log("Unable to bind action %s, a binding needs 1 to %d keys!\n", mNames[action].c_str(), WY_CHORD_KEYS);
+            return false;
+        }
+
+        Binding binding = {action, (int)keys.size(), {}, bScancode};
+        int i = 0;
+        for (SDL_Keycode key : keys)
+        {
+            binding.keys[i++] = key;
+        }
+
+        mBindings.push_back(binding);
+        bDirty = true;
+        return true;
+    }
+
+    static bool testBit(const Uint64 *bits, SDL_Scancode code)
+    {
+        return (unsigned)code < SDL_NUM_SCANCODES && (bits[code >> 6] >> (code & 63)) & 1;
+    }
+
+public:
+    WY_ActionMap() {}
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    // Returns the action's id, or -1 if there is no action by that name
+    int getAction(const std::string &name)
+    {
+        for (size_t i = 0; i < mNames.size(); i++)
+        {
+            if (mNames[i] == name)
+            {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+    const std::string &getActionName(int action)
+    {
+        return mNames[action];
+    }
+
+    int getActionCount()
+    {
+        return mNames.size();
+    }
+
+    int getBindingCount()
+    {
+        return mBindings.size();
+    }
+
+    // The queries are false for ids addAction() didn't return (e.g. -1)
+
+    bool isDown(int action)
+    {
+        return getBit(mDown, action);
+    }
+
+    bool isUp(int action)
+    {
+        return getBit(~mDown, action);
+    }
+
+    bool isPressed(int action)
+    {
+        return getBit(mDown & ~mPrevDown, action);
+    }
+
+    bool isReleased(int action)
+    {
+        return getBit(~mDown & mPrevDown, action);
+    }
+
+    // All actions that are down, one bit per action id
+    Uint64 getState()
+    {
+        return mDown;
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    // Adds an action (or finds the existing one by that name) and returns its id,
+    // or -1 if there are already WY_MAX_ACTIONS actions.
+    int addAction(const std::string &name)
+    {
+        int action = getAction(name);
+        if (action >= 0)
+        {
+            return action;
+        }
+
+        if (mNames.size() >= WY_MAX_ACTIONS)
+        {
+            SDL_Log("Unable to add action %s, there are already %d actions!\n", name.c_str(), WY_MAX_ACTIONS);
+            return -1;
+        }
+
+        mNames.push_back(name);
+        return mNames.size() - 1;
+    }
+
+    // Binds a key (SDLK_*) to the action
+    bool bind(int action, SDL_Keycode key)
+    {
+        return bind(action, {key});
+    }
+
+    // Binds a chord: the action is down while all of the keys are held
+    bool bind(int action, std::initializer_list<SDL_Keycode> keys)
+    {
+        return addBinding(action, keys, false);
+    }
+
+    // Binds a physical key position (SDL_SCANCODE_*), e.g. for WASD on any layout
+    bool bindScancode(int action, SDL_Scancode code)
+    {
+        return bindScancode(action, {code});
+    }
+
+    bool bindScancode(int action, std::initializer_list<SDL_Scancode> codes)
+    {
+        std::vector<SDL_Keycode> keys(codes.begin(), codes.end());
+        return addBinding(action, keys, true);
+    }
+
+    // Removes all of the action's bindings
+    void unbind(int action)
+    {
+        for (size_t i = 0; i < mBindings.size();)
+        {
+            if (mBindings[i].action == action)
+            {
+                mBindings.erase(mBindings.begin() + i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        bDirty = true;
+    }
+
+    // Call once per frame, after keyboard->update
+    void update(WY_Keyboard *keyboard, const WY_EventBuffer &events)
+    {
+        if (bDirty || events.has(SDL_KEYMAPCHANGED))
+        {
+            compile();
+        }
+
+        mPrevDown = mDown;
+        mDown = 0;
+
+        const Uint64 *state = keyboard->getState();
+        for (int w = 0; w < WY_KEY_WORDS; w++)
+        {
+            Uint64 bits = state[w];
+            int code = w * 64;
+
+            while (bits != 0)
+            {
+                if ((bits & 0xFF) == 0)
+                {
+                    bits >>= 8;
+                    code += 8;
+                    continue;
+                }
+
+                if (bits & 1)
+                {
+                    mDown |= mKeyActions[code];
+
+                    for (int c = mChordStart[code]; c < mChordStart[code + 1]; c++)
+                    {
+                        const Chord &chord = mChords[c];
+                        if ((mDown & chord.mask) != 0)
+                        {
+                            continue;
+                        }
+
+                        bool bHeld = true;
+                        for (int i = 0; i < chord.nKeys && bHeld; i++)
+                        {
+                            bHeld = testBit(state, chord.keys[i]);
+                        }
+                        if (bHeld)
+                        {
+                            mDown |= chord.mask;
+                        }
+                    }
+                }
+
+                bits >>= 1;
+                code++;
+            }
+        }
+    }
+};
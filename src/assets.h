@@ -0,0 +1,237 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "image.h"
+
+// Shared, reference-counted image. The texture is destroyed when the last
+// handle goes away, so game code never calls SDL_DestroyTexture on it.
+typedef std::shared_ptr<WY_Image> WY_ImageHandle;
+
+struct WY_AssetStats
+{
+    int nHits = 0;          // loads served from the cache
+    int nMisses = 0;        // loads that decoded the file
+    int nEvictions = 0;     // images dropped to stay within budget
+    size_t nBytesLoaded = 0;   // total texture bytes ever decoded
+    size_t nBytesResident = 0; // texture bytes currently held by the cache
+    double dLoadTime = 0.0;    // total time spent decoding, in ms
+};
+
+class WY_AssetCache
+{
+    struct Entry
+    {
+        WY_ImageHandle image;
+        size_t nBytes;
+        std::list<std::string>::iterator lru;
+    };
+
+    SDL_Renderer *mRenderer;
+    std::unordered_map<std::string, Entry> mImages;
+    std::list<std::string> mLRU; // most recently used first
+    size_t mBudget;              // texture memory budget in bytes, 0 = unlimited
+    WY_AssetStats mStats;
+
+    static void destroyImage(WY_Image *image)
+    {
+        SDL_DestroyTexture(image->texture);
+        delete image;
+    }
+
+public:
+    WY_AssetCache(SDL_Renderer *renderer, size_t budget = 0)
+    {
+        mRenderer = renderer;
+        mBudget = budget;
+    }
+
+    ~WY_AssetCache()
+    {
+        clear();
+    }
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    const WY_AssetStats &getStats()
+    {
+        return mStats;
+    }
+
+    SDL_Renderer *getRenderer()
+    {
+        return mRenderer;
+    }
+
+    size_t getBudget()
+    {
+        return mBudget;
+    }
+
+    int getImageCount()
+    {
+        return mImages.size();
+    }
+
+    // ==================================================
+    // Setters
+    // ==================================================
+
+    // Changing the budget evicts unused images right away if needed
+    void setBudget(size_t budget)
+    {
+        mBudget = budget;
+        trim();
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    // Returns the cached image at path (counted as a hit), or an empty handle
+    WY_ImageHandle findImage(const std::string &path)
+    {
+        auto found = mImages.find(path);
+        if (found == mImages.end())
+        {
+            return WY_ImageHandle();
+        }
+
+        mStats.nHits++;
+        mLRU.splice(mLRU.begin(), mLRU, found->second.lru);
+        return found->second.image;
+    }
+
+    // Takes ownership of an image decoded outside the cache (counted as a miss),
+    // e.g. by WY_ImageLoader. dLoadTime is the time it took to decode, in ms.
+    WY_ImageHandle addImage(const std::string &path, WY_Image *newImage, double dLoadTime)
+    {
+        WY_ImageHandle image(newImage, destroyImage);
+
+        mStats.nMisses++;
+        mStats.dLoadTime += dLoadTime;
+
+        if (image->texture == NULL)
+        {
+            // Don't cache failures, so the file can be retried later
+            return image;
+        }
+
+        auto found = mImages.find(path);
+        if (found != mImages.end())
+        {
+            // Replaces an older copy; handles to it stay valid
+            mStats.nBytesResident -= found->second.nBytes;
+            mLRU.erase(found->second.lru);
+            mImages.erase(found);
+        }
+
+        size_t nBytes = (size_t)image->w * image->h * 4; // RGBA8888
+        mStats.nBytesLoaded += nBytes;
+        mStats.nBytesResident += nBytes;
+
+        mLRU.push_front(path);
+        mImages[path] = {image, nBytes, mLRU.begin()};
+
+        trim();
+
+        return image;
+    }
+
+    // Returns the image at path, decoding it only if it isn't cached yet
+    WY_ImageHandle loadImage(const std::string &path)
+    {
+        WY_ImageHandle image = findImage(path);
+        if (image)
+        {
+            return image;
+        }
+
+        Uint64 nStart = SDL_GetPerformanceCounter();
+        WY_Image *newImage = loadPNG(mRenderer, path);
+        double dLoadTime = (SDL_GetPerformanceCounter() - nStart) * 1000.0 / SDL_GetPerformanceFrequency();
+
+        return addImage(path, newImage, dLoadTime);
+    }
+
+    // Loads every image listed in a manifest file (one path per line,
+    // blank lines and lines starting with '#' are skipped).
+    // Returns the number of images that loaded successfully.
+    int preload(const std::string &manifest)
+    {
+        std::ifstream ifs;
+        ifs.open(manifest);
+        if (!ifs.is_open())
+        {
+            SDL_Log("Unable to open asset manifest %s!\n", manifest.c_str());
+            return 0;
+        }
+
+        int nLoaded = 0;
+        std::string line;
+        while (std::getline(ifs, line))
+        {
+            // tolerate CRLF manifests
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            if (loadImage(line)->texture != NULL)
+            {
+                nLoaded++;
+            }
+        }
+
+        return nLoaded;
+    }
+
+    // Evicts least recently used images that nobody holds a handle to,
+    // until resident texture memory fits in the budget.
+    void trim()
+    {
+        if (mBudget == 0)
+        {
+            return;
+        }
+
+        auto path = mLRU.end();
+        while (mStats.nBytesResident > mBudget && path != mLRU.begin())
+        {
+            --path;
+
+            Entry &entry = mImages[*path];
+            if (entry.image.use_count() > 1)
+            {
+                continue; // still in use
+            }
+
+            mStats.nBytesResident -= entry.nBytes;
+            mStats.nEvictions++;
+
+            mImages.erase(*path);
+            path = mLRU.erase(path);
+        }
+    }
+
+    // Drops every cached image; textures still referenced elsewhere stay alive
+    // until their last handle is released.
+    void clear()
+    {
+        mImages.clear();
+        mLRU.clear();
+        mStats.nBytesResident = 0;
+    }
+};
@@ -0,0 +1,505 @@
+// Texture atlas
+//
+// Packs many images (or regions of sprite sheets) into a few shared pages,
+// so sprites and fonts drawn together stay on the same texture and the
+// renderer doesn't switch textures between nearly every draw.
+//
+// Runtime:
+//   WY_Atlas atlas;
+//   atlas.addImage("font", "assets/ascii-bnw.png");
+//   atlas.addTiles("bunny", "assets/lineup-fixed.png", 35, 36); // bunny:0, bunny:1, ...
+//   atlas.build(renderer);
+//   WY_Sprite bunny = atlas.getSprite("bunny:3");
+//
+// Offline (see demos/atlas-pack.cpp): pack() and save("assets/sprites.atlas")
+// write the pages as PNGs plus an index; load(renderer, "assets/sprites.atlas")
+// then skips decoding the sources and packing at startup.
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "image.h"
+
+// Bottom-left skyline packer for a single page
+class WY_Skyline
+{
+    struct Node
+    {
+        int x, y, w;
+    };
+
+    int mW, mH;
+    std::vector<Node> mNodes;
+
+    // Lowest y at which a w x h rect fits with its left edge at node i, or -1
+    int fit(int i, int w, int h)
+    {
+        if (mNodes[i].x + w > mW)
+        {
+            return -1;
+        }
+
+        int y = mNodes[i].y;
+        int remaining = w;
+        for (int j = i; remaining > 0; j++)
+        {
+            y = std::max(y, mNodes[j].y);
+            if (y + h > mH)
+            {
+                return -1;
+            }
+            remaining -= mNodes[j].w;
+        }
+        return y;
+    }
+
+public:
+    WY_Skyline(int w, int h)
+    {
+        mW = w;
+        mH = h;
+        mNodes.push_back({0, 0, w});
+    }
+
+    // Finds room for a w x h rect, preferring the lowest then narrowest spot
+    bool insert(int w, int h, int &x, int &y)
+    {
+        int best = -1;
+        int bestY = mH;
+        int bestW = mW;
+
+        for (int i = 0; i < (int)mNodes.size(); i++)
+        {
+            int ny = fit(i, w, h);
+            if (ny >= 0 && (ny < bestY || (ny == bestY && mNodes[i].w < bestW)))
+            {
+                best = i;
+                bestY = ny;
+                bestW = mNodes[i].w;
+            }
+        }
+
+        if (best < 0)
+        {
+            return false;
+        }
+
+        x = mNodes[best].x;
+        y = bestY;
+
+        // Raise the skyline under the new rect, then trim what it now covers
+        mNodes.insert(mNodes.begin() + best, {x, y + h, w});
+        for (int i = best + 1; i < (int)mNodes.size(); i++)
+        {
+            int overlap = x + w - mNodes[i].x;
+            if (overlap <= 0)
+            {
+                break;
+            }
+
+            mNodes[i].x += overlap;
+            mNodes[i].w -= overlap;
+            if (mNodes[i].w > 0)
+            {
+                break;
+            }
+            mNodes.erase(mNodes.begin() + i--);
+        }
+
+        // Merge neighbours at the same height
+        for (int i = 0; i + 1 < (int)mNodes.size(); i++)
+        {
+            if (mNodes[i].y == mNodes[i + 1].y)
+            {
+                mNodes[i].w += mNodes[i + 1].w;
+                mNodes.erase(mNodes.begin() + i + 1);
+                i--;
+            }
+        }
+
+        return true;
+    }
+};
+
+class WY_Atlas
+{
+    struct Entry
+    {
+        int page;
+        SDL_Rect rect; // on the page
+    };
+
+    struct Pending
+    {
+        std::string name;
+        SDL_Surface *source; // owned by mSources
+        SDL_Rect region;     // on the source
+    };
+
+    int mPageSize;
+    int mPadding; // empty pixels around each sprite, against filtering bleed
+
+    SDL_Renderer *mRenderer = nullptr;
+    std::unordered_map<std::string, SDL_Surface *> mSources; // decoded sources, by path
+    std::vector<Pending> mPending;
+
+    std::unordered_map<std::string, Entry> mEntries;
+    std::vector<WY_Image *> mPages;
+    std::vector<SDL_Surface *> mPageSurfaces; // packed pages after mPages, until upload()
+
+    SDL_Surface *getSource(const std::string &path)
+    {
+        auto found = mSources.find(path);
+        if (found != mSources.end())
+        {
+            return found->second;
+        }
+
+        // Pages are RGBA8888, so sources must be too
+        SDL_Surface *source = decodePNG(path, false);
+        mSources[path] = source;
+        return source;
+    }
+
+    void freeSources()
+    {
+        for (auto &source : mSources)
+        {
+            if (source.second != NULL)
+            {
+                SDL_FreeSurface(source.second);
+            }
+        }
+        mSources.clear();
+        mPending.clear();
+    }
+
+    void freePageSurfaces()
+    {
+        for (auto surface : mPageSurfaces)
+        {
+            SDL_FreeSurface(surface);
+        }
+        mPageSurfaces.clear();
+    }
+
+    SDL_Surface *createPage()
+    {
+        SDL_Surface *page = SDL_CreateRGBSurfaceWithFormat(0, mPageSize, mPageSize, 32, SDL_PIXELFORMAT_RGBA8888);
+        if (page == NULL)
+        {
+            SDL_Log("Unable to create atlas page! SDL Error: %s\n", SDL_GetError());
+            return NULL;
+        }
+
+        // Fill with the color key, so padding ends up transparent once uploaded
+        SDL_FillRect(page, NULL, SDL_MapRGB(page->format, 0xFF, 0xFF, 0xFF));
+        mPageSurfaces.push_back(page);
+        return page;
+    }
+
+    static std::string directoryOf(const std::string &file)
+    {
+        size_t slash = file.find_last_of("/\\");
+        return slash == std::string::npos ? "" : file.substr(0, slash + 1);
+    }
+
+public:
+    WY_Atlas(int pageSize = 2048, int padding = 1)
+    {
+        mPageSize = pageSize;
+        mPadding = padding;
+    }
+
+    ~WY_Atlas()
+    {
+        clear();
+    }
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    int getPageCount()
+    {
+        return mPages.size() + mPageSurfaces.size();
+    }
+
+    int getSpriteCount()
+    {
+        return mEntries.size();
+    }
+
+    bool hasSprite(const std::string &name)
+    {
+        return mEntries.find(name) != mEntries.end();
+    }
+
+    SDL_Texture *getTexture(int page)
+    {
+        return page < (int)mPages.size() ? mPages[page]->texture : NULL;
+    }
+
+    // Sprite drawing from the shared page. Unknown names give a sprite with no texture.
+    WY_Sprite getSprite(const std::string &name)
+    {
+        auto found = mEntries.find(name);
+        if (found == mEntries.end())
+        {
+            SDL_Log("Atlas has no sprite named %s!\n", name.c_str());
+            return {mRenderer, NULL, {0, 0, 0, 0}};
+        }
+
+        return {mRenderer, getTexture(found->second.page), found->second.rect};
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    // Queues a whole image
+    void addImage(const std::string &name, const std::string &path)
+    {
+        SDL_Surface *source = getSource(path);
+        if (source != NULL)
+        {
+            addRegion(name, path, {0, 0, source->w, source->h});
+        }
+    }
+
+    // Queues one region of a sprite sheet
+    void addRegion(const std::string &name, const std::string &path, SDL_Rect region)
+    {
+        SDL_Surface *source = getSource(path);
+        if (source == NULL)
+        {
+            return;
+        }
+
+        SDL_Rect bounds = {0, 0, source->w, source->h};
+        if (!SDL_IntersectRect(&region, &bounds, &region))
+        {
+            SDL_Log("Atlas region %s is outside of %s!\n", name.c_str(), path.c_str());
+            return;
+        }
+
+        mPending.push_back({name, source, region});
+    }
+
+    // Queues every tileW x tileH tile of a sprite sheet as "name:0", "name:1", ...
+    // in row-major order. Returns the number of tiles.
+    int addTiles(const std::string &name, const std::string &path, int tileW, int tileH)
+    {
+        SDL_Surface *source = getSource(path);
+        if (source == NULL || tileW <= 0 || tileH <= 0)
+        {
+            return 0;
+        }
+
+        int count = 0;
+        for (int y = 0; y + tileH <= source->h; y += tileH)
+        {
+            for (int x = 0; x + tileW <= source->w; x += tileW)
+            {
+                addRegion(name + ":" + std::to_string(count++), path, {x, y, tileW, tileH});
+            }
+        }
+        return count;
+    }
+
+    // Packs everything queued so far into page surfaces (CPU only; no renderer needed).
+    // Returns false if a sprite is larger than a page.
+    bool pack()
+    {
+        bool ok = true;
+
+        // Tallest first keeps the skyline flat
+        std::stable_sort(mPending.begin(), mPending.end(), [](const Pending &a, const Pending &b) {
+            return a.region.h != b.region.h ? a.region.h > b.region.h : a.region.w > b.region.w;
+        });
+
+        std::vector<WY_Skyline> skylines;
+        for (size_t i = 0; i < mPageSurfaces.size(); i++)
+        {
+            // Earlier pages are full enough; new sprites start a fresh page
+            skylines.push_back(WY_Skyline(0, 0));
+        }
+
+        for (auto &pending : mPending)
+        {
+            int w = pending.region.w + mPadding * 2;
+            int h = pending.region.h + mPadding * 2;
+            int x = 0, y = 0;
+
+            int page = 0;
+            while (page < (int)skylines.size() && !skylines[page].insert(w, h, x, y))
+            {
+                page++;
+            }
+
+            if (page == (int)skylines.size())
+            {
+                skylines.push_back(WY_Skyline(mPageSize, mPageSize));
+                if (createPage() == NULL || !skylines[page].insert(w, h, x, y))
+                {
+                    SDL_Log("Unable to fit %s (%dx%d) in a %d atlas page!\n", pending.name.c_str(), pending.region.w, pending.region.h, mPageSize);
+                    skylines.pop_back();
+                    ok = false;
+                    continue;
+                }
+            }
+
+            SDL_Rect rect = {x + mPadding, y + mPadding, pending.region.w, pending.region.h};
+            SDL_Surface *target = mPageSurfaces[page];
+            SDL_Surface *source = pending.source;
+
+            for (int row = 0; row < rect.h; row++)
+            {
+                memcpy((Uint8 *)target->pixels + (rect.y + row) * target->pitch + rect.x * 4,
+                       (Uint8 *)source->pixels + (pending.region.y + row) * source->pitch + pending.region.x * 4,
+                       rect.w * 4);
+            }
+
+            mEntries[pending.name] = {(int)mPages.size() + page, rect};
+        }
+
+        freeSources();
+        return ok;
+    }
+
+    // Turns packed pages into textures. Must be called from the thread that owns the renderer.
+    void upload(SDL_Renderer *renderer)
+    {
+        mRenderer = renderer;
+
+        for (auto surface : mPageSurfaces)
+        {
+            mPages.push_back(uploadImage(renderer, surface, "atlas page " + std::to_string(mPages.size())));
+        }
+
+        freePageSurfaces();
+    }
+
+    bool build(SDL_Renderer *renderer)
+    {
+        bool ok = pack();
+        upload(renderer);
+        return ok;
+    }
+
+    // Writes packed pages next to the index as <index>-0.png, <index>-1.png, ...
+    // Only pages not uploaded yet are saved, so call it between pack() and upload().
+    bool save(const std::string &file)
+    {
+        std::ofstream ofs;
+        ofs.open(file, std::fstream::out | std::ios::trunc);
+        if (!ofs.is_open())
+        {
+            SDL_Log("Unable to write atlas index %s!\n", file.c_str());
+            return false;
+        }
+
+        std::string name = file.substr(directoryOf(file).size());
+
+        ofs << "wyatlas 1\n";
+        for (size_t i = 0; i < mPageSurfaces.size(); i++)
+        {
+            std::string page = name + "-" + std::to_string(i) + ".png";
+            if (IMG_SavePNG(mPageSurfaces[i], (directoryOf(file) + page).c_str()) != 0)
+            {
+                SDL_Log("Unable to write atlas page %s! SDL_image Error: %s\n", page.c_str(), IMG_GetError());
+                return false;
+            }
+            ofs << "page " << page << "\n";
+        }
+
+        for (auto &entry : mEntries)
+        {
+            SDL_Rect &r = entry.second.rect;
+            ofs << "sprite " << entry.second.page << " " << r.x << " " << r.y << " " << r.w << " " << r.h << " " << entry.first << "\n";
+        }
+
+        return ofs.good();
+    }
+
+    // Loads pages and sprites written by save(), replacing the current contents
+    bool load(SDL_Renderer *renderer, const std::string &file)
+    {
+        clear();
+
+        std::ifstream ifs;
+        ifs.open(file);
+        if (!ifs.is_open())
+        {
+            SDL_Log("Unable to open atlas index %s!\n", file.c_str());
+            return false;
+        }
+
+        std::string line, tag;
+        std::getline(ifs, line);
+        if (line.rfind("wyatlas 1", 0) != 0)
+        {
+            SDL_Log("Invalid atlas index %s!\n", file.c_str());
+            return false;
+        }
+
+        while (std::getline(ifs, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            std::istringstream iss(line);
+            iss >> tag;
+
+            if (tag == "page")
+            {
+                std::string page;
+                iss >> page;
+
+                SDL_Surface *surface = decodePNG(directoryOf(file) + page);
+                if (surface == NULL)
+                {
+                    clear();
+                    return false;
+                }
+                mPageSurfaces.push_back(surface);
+            }
+            else if (tag == "sprite")
+            {
+                Entry entry;
+                std::string name;
+                iss >> entry.page >> entry.rect.x >> entry.rect.y >> entry.rect.w >> entry.rect.h >> std::ws;
+                std::getline(iss, name);
+                mEntries[name] = entry;
+            }
+        }
+
+        upload(renderer);
+        return true;
+    }
+
+    // Destroys all pages; sprites taken from them become invalid
+    void clear()
+    {
+        freeSources();
+        freePageSurfaces();
+
+        for (auto page : mPages)
+        {
+            SDL_DestroyTexture(page->texture);
+            delete page;
+        }
+        mPages.clear();
+        mEntries.clear();
+    }
+};
@@ -15,16 +15,66 @@
 // NES audio channels
 // https://www.youtube.com/watch?v=la3coK5pq5w
 
+// Audio latency
+// https://developer.android.com/ndk/guides/audio/audio-latency
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <atomic>
 #include <SDL2/SDL.h>
+#include <vector>
 #include "../math.h"
+#include "mixbus.h"
+
+// Callback intervals are sorted into this many bins, each 1/8 of a buffer's duration wide
+#define WY_AUDIO_HISTOGRAM_BINS 16
 
 namespace wyaudio
 {
     void audioCallback(void *userData, Uint8 *stream, int streamLen);
 
+    // What to ask the audio device for. The device may give something else
+    // where nAllowedChanges permits it; WY_Audio uses whatever it gets.
+    struct WY_AudioConfig
+    {
+        int nSampleRate = 44100;
+        int nFrames = 1024; // buffer size in frames (samples per channel); smaller = lower latency
+        int nChannels = 2;
+        SDL_AudioFormat format = AUDIO_S16SYS; // AUDIO_S16SYS or AUDIO_F32SYS
+        int nAllowedChanges = 0;               // SDL_AUDIO_ALLOW_* flags
+        const char *device = NULL;             // NULL for the default device
+
+        // Small float32 buffers, taking the device's native rate and format so
+        // SDL doesn't have to convert (and buffer) in between.
+        // 128 frames is ~3 ms at 44.1kHz, but may underrun on slow machines.
+        static WY_AudioConfig lowLatency(int frames = 256)
+        {
+            WY_AudioConfig config;
+            config.nFrames = frames;
+            config.format = AUDIO_F32SYS;
+            config.nAllowedChanges = SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_FORMAT_CHANGE;
+            return config;
+        }
+    };
+
+    // Measured in the audio callback. Times are in ms.
+    struct WY_AudioStats
+    {
+        Uint64 nCallbacks = 0;
+        int nUnderruns = 0;          // callbacks that came (or finished) later than the buffer lasts
+        double dPeriod = 0.0;        // how long one buffer plays
+        double dIntervalMean = 0.0;  // time between callbacks
+        double dIntervalMax = 0.0;
+        double dJitter = 0.0;        // mean difference between the interval and dPeriod
+        double dRenderMean = 0.0;    // time spent filling a buffer
+        double dRenderMax = 0.0;
+        double dTriggerMean = 0.0;   // from markTrigger() to the callback that renders it
+        int nTriggers = 0;
+        int nHistogram[WY_AUDIO_HISTOGRAM_BINS] = {0}; // intervals, bin i = [i/8, (i+1)/8) periods; last bin is 15/8 and up
+    };
+
     class WY_Audio
     {
     protected:
@@ -37,7 +87,8 @@ namespace wyaudio
         // Frequency, a.k.a. number of samples per second. Higher value = higher accuracy
         int nSampleRate; // e.g. 44100
 
-        // Current sample (phase) position
+        // Current sample (phase) position: the time of the next frame to be
+        // rendered, in seconds. Advances by 1 / nSampleRate per frame.
         // Reference: https://en.wikipedia.org/wiki/Phase_(waves)
         double dTime = 0.0;
 
@@ -59,12 +110,61 @@ namespace wyaudio
         */
         SDL_AudioFormat audioFormat = AUDIO_S16;
 
+        // Callback timing, written by the audio thread
+        WY_AudioStats mStats;
+        Uint64 nLastCallback = 0;
+        double dIntervalSum = 0.0;
+        double dJitterSum = 0.0;
+        double dRenderSum = 0.0;
+        double dTriggerSum = 0.0;
+        std::atomic<Uint64> nTriggerTime{0};
+        double dCallbackTime = 0.0; // dTime at the start of the last callback
+
+        // Float32 mix bus, see mixbus.h
+        std::vector<float> mBus;
+        float fClipThreshold = 0.8f; // soft clipping starts here; 1.0 turns it off
+        bool bDither = false;
+        Uint32 mDitherState[WY_DITHER_LANES];
+
         // Overwrite this to create your own audio sample.
         // Do not printf/log here as it will be very slow;
         // It runs at a high frequency, e.g. ~44100 per frame
         // - Runs in audio thread, use mutex when possible.
         // - Expects a return value between -1 to 1.
-        virtual double getAudioSample() = 0;
+        virtual double getAudioSample()
+        {
+            return 0.0;
+        }
+
+        // Or overwrite this to render a whole buffer at once: frames frames of
+        // nChannels interleaved float samples (-1 to 1), starting at dTime.
+        // Must advance dTime by frames / nSampleRate.
+        virtual void renderBlock(float *bus, int frames)
+        {
+            double dTimeDelta = 1.0 / (double)nSampleRate;
+            double dStart = dTime;
+
+            // One sample per frame, the same in every channel
+            for (int f = 0; f < frames; f++)
+            {
+                dTime = dStart + f * dTimeDelta;
+
+                float sample = (float)getAudioSample();
+                for (int c = 0; c < nChannels; c++)
+                {
+                    bus[f * nChannels + c] = sample;
+                }
+
+                // dTime doesn't have to wrap;
+                // While basic (e.g. sine) waves theoretically can go on forever,
+                // non-basic waves do not have a 2PI and won't cleanly wrap.
+                // We assume in such cases we will turn them off manually,
+                // and reset dTime so that the wave plays cleanly from beginning.
+            }
+
+            // From the block start, so rounding doesn't pile up sample by sample
+            dTime = dStart + frames * dTimeDelta;
+        }
 
         virtual void onPlay() {}
         virtual void onPause() {}
@@ -117,10 +217,81 @@ namespace wyaudio
             return dTime;
         }
 
+        // Estimated dTime of the frame being heard right now, for syncing
+        // visuals to the audio. The buffer rendered in the last callback
+        // starts playing about one buffer later, and then plays in real time.
+        double getPlaybackTime()
+        {
+            SDL_LockAudioDevice(deviceId);
+            double start = dCallbackTime;
+            double end = dTime;
+            Uint64 callback = nLastCallback;
+            double period = mStats.dPeriod / 1000.0;
+            SDL_UnlockAudioDevice(deviceId);
+
+            if (callback == 0)
+            {
+                return start;
+            }
+
+            double elapsed = (double)(SDL_GetPerformanceCounter() - callback) / SDL_GetPerformanceFrequency();
+            double time = start + elapsed - period;
+
+            // Never ahead of what has been rendered
+            return SDL_min(time, end);
+        }
+
+        SDL_AudioFormat getFormat()
+        {
+            return haveSpec.format;
+        }
+
+        // Frames per buffer the device actually uses
+        int getBufferFrames()
+        {
+            return haveSpec.samples;
+        }
+
+        // A copy of the callback timings so far
+        WY_AudioStats getStats()
+        {
+            SDL_LockAudioDevice(deviceId);
+            WY_AudioStats stats = mStats;
+            SDL_UnlockAudioDevice(deviceId);
+
+            return stats;
+        }
+
+        // Estimated time in ms from a markTrigger() call until it can be heard:
+        // the measured wait for the callback that renders it, plus one buffer
+        // playing out ahead of it. Excludes the OS mixer and hardware, which
+        // SDL can't see.
+        double getOutputLatency()
+        {
+            WY_AudioStats stats = getStats();
+            double wait = stats.nTriggers > 0 ? stats.dTriggerMean : stats.dPeriod / 2;
+
+            return wait + stats.dPeriod;
+        }
+
         // ==================================================
         // Setters
         // ==================================================
 
+        // Level (0 to 1) above which the mix is softly clipped; 1.0 turns it off
+        void setClipThreshold(float threshold)
+        {
+            SDL_LockAudioDevice(deviceId);
+            fClipThreshold = SDL_min(SDL_max(threshold, 0.0f), 1.0f);
+            SDL_UnlockAudioDevice(deviceId);
+        }
+
+        // TPDF dither when converting to S16
+        void setDither(bool dither)
+        {
+            bDither = dither;
+        }
+
         // Increase or decrease amplitude
         void changeAmplitude(int vol)
         {
@@ -138,6 +309,17 @@ namespace wyaudio
         // ==================================================
 
         void init(unsigned int sampleRate = 44100, unsigned int sampleSize = 1024, unsigned int channels = 2, unsigned int amplitude = 500)
+        {
+            WY_AudioConfig config;
+            config.nSampleRate = sampleRate;
+            config.nFrames = sampleSize;
+            config.nChannels = channels;
+            config.format = audioFormat;
+
+            init(config, amplitude);
+        }
+
+        void init(const WY_AudioConfig &config, unsigned int amplitude = 500)
         {
             if (SDL_Init(SDL_INIT_AUDIO) < 0)
             {
@@ -148,32 +330,61 @@ namespace wyaudio
             SDL_zero(wantSpec);
             SDL_zero(haveSpec);
 
-            wantSpec.freq = sampleRate;
-            wantSpec.format = audioFormat;
-            wantSpec.channels = channels;
-            wantSpec.samples = sampleSize;
+            wantSpec.freq = config.nSampleRate;
+            wantSpec.format = config.format;
+            wantSpec.channels = config.nChannels;
+            wantSpec.samples = config.nFrames;
             wantSpec.callback = audioCallback;
             wantSpec.userdata = this;
 
-            deviceId = SDL_OpenAudioDevice(NULL, 0, &wantSpec, &haveSpec, 0);
+            deviceId = SDL_OpenAudioDevice(config.device, 0, &wantSpec, &haveSpec, config.nAllowedChanges);
+
+            // Only S16 and F32 are rendered; have SDL convert anything else
+            if (deviceId > 0 && haveSpec.format != AUDIO_S16SYS && haveSpec.format != AUDIO_F32SYS)
+            {
+                SDL_CloseAudioDevice(deviceId);
+                deviceId = SDL_OpenAudioDevice(config.device, 0, &wantSpec, &haveSpec, config.nAllowedChanges & ~SDL_AUDIO_ALLOW_FORMAT_CHANGE);
+            }
+
             if (deviceId == 0)
             {
                 SDL_Log("\nFailed to open audio: %s\n", SDL_GetError());
                 return;
             }
-            if (wantSpec.format != haveSpec.format)
+            if (wantSpec.format != haveSpec.format || wantSpec.samples != haveSpec.samples || wantSpec.freq != haveSpec.freq)
             {
-                SDL_Log("\nFailed to get the desired AudioSpec");
+                SDL_Log("\nAudio device differs from the desired AudioSpec: %d Hz, %d frames, format %x", haveSpec.freq, haveSpec.samples, haveSpec.format);
             }
 
+            audioFormat = haveSpec.format;
             nSampleRate = haveSpec.freq;
             nSampleSize = haveSpec.size / haveSpec.channels;
             nChannels = haveSpec.channels;
             nAmplitude = amplitude;
 
+            mStats = WY_AudioStats();
+            mStats.dPeriod = 1000.0 * haveSpec.samples / haveSpec.freq;
+            nLastCallback = 0;
+            dIntervalSum = dJitterSum = dRenderSum = dTriggerSum = 0.0;
+
+            // Sized once here so the callback doesn't allocate
+            mBus.resize(haveSpec.samples * haveSpec.channels);
+            for (int i = 0; i < WY_DITHER_LANES; i++)
+            {
+                mDitherState[i] = 0x9E3779B9u * (i + 1);
+            }
+
             bInit = true;
         }
 
+        // Call when something audible is triggered (e.g. a note starts), to
+        // measure how long it waits for the audio callback.
+        void markTrigger()
+        {
+            Uint64 expected = 0;
+            nTriggerTime.compare_exchange_strong(expected, SDL_GetPerformanceCounter());
+        }
+
         // Plays audio. Will also init if called for the first time.
         void play()
         {
@@ -195,7 +406,56 @@ namespace wyaudio
         // Used by audioCallback. Do not call or override this.
         void updateAudio(Uint8 *stream, int streamLen)
         {
-            Sint16 *buffer = (Sint16 *)stream;
+            Uint64 start = SDL_GetPerformanceCounter();
+            double msPerCount = 1000.0 / SDL_GetPerformanceFrequency();
+
+            Uint64 trigger = nTriggerTime.exchange(0);
+            if (trigger != 0)
+            {
+                dTriggerSum += (start - trigger) * msPerCount;
+                mStats.nTriggers++;
+                mStats.dTriggerMean = dTriggerSum / mStats.nTriggers;
+            }
+
+            dCallbackTime = dTime;
+            renderAudio(stream, streamLen);
+
+            Uint64 end = SDL_GetPerformanceCounter();
+            double render = (end - start) * msPerCount;
+
+            mStats.nCallbacks++;
+            dRenderSum += render;
+            mStats.dRenderMean = dRenderSum / mStats.nCallbacks;
+            mStats.dRenderMax = SDL_max(mStats.dRenderMax, render);
+
+            bool bLate = render > mStats.dPeriod;
+            if (nLastCallback != 0)
+            {
+                double interval = (start - nLastCallback) * msPerCount;
+                int intervals = mStats.nCallbacks - 1;
+
+                dIntervalSum += interval;
+                dJitterSum += fabs(interval - mStats.dPeriod);
+                mStats.dIntervalMean = dIntervalSum / intervals;
+                mStats.dIntervalMax = SDL_max(mStats.dIntervalMax, interval);
+                mStats.dJitter = dJitterSum / intervals;
+
+                int bin = (int)(interval / mStats.dPeriod * 8);
+                mStats.nHistogram[SDL_min(SDL_max(bin, 0), WY_AUDIO_HISTOGRAM_BINS - 1)]++;
+
+                // A buffer should be asked for about every period; taking half
+                // again as long means the device likely ran dry
+                bLate = bLate || interval > mStats.dPeriod * 1.5;
+            }
+            mStats.nUnderruns += bLate;
+
+            nLastCallback = start;
+        }
+
+    private:
+        void renderAudio(Uint8 *stream, int streamLen)
+        {
+            static const WY_MixKernels kernels = getMixKernels();
 
             /**
              * stream length is (sampleSize * channels * byte format).
@@ -206,21 +466,27 @@ namespace wyaudio
              * audioFormat = AUDIO_S16
              * streamLen = 1024 * 2 * 2 (S16 = 2 bytes) = 4096
              */
-            int bufferLength = streamLen / 2; // 2 bytes per sample for AUDIO_S16SYS
+            int bufferLength = streamLen / (SDL_AUDIO_BITSIZE(audioFormat) / 8); // 2 bytes per sample for AUDIO_S16SYS, 4 for AUDIO_F32SYS
 
-            double dTimeDelta = 1.0 / (double)nSampleRate;
-
-            for (int i = 0; i < bufferLength; i++)
+            if ((int)mBus.size() < bufferLength)
             {
-                buffer[i] = nAmplitude * getAudioSample();
+                mBus.resize(bufferLength);
+            }
+            float *bus = mBus.data();
 
-                dTime += dTimeDelta;
+            renderBlock(bus, bufferLength / nChannels);
 
-                // dTime doesn't have to wrap;
-                // While basic (e.g. sine) waves theoretically can go on forever,
-                // non-basic waves do not have a 2PI and won't cleanly wrap.
-                // We assume in such cases we will turn them off manually,
-                // and reset dTime so that the wave plays cleanly from beginning.
+            // One pass from the bus to the device: gain (nAmplitude is in S16
+            // units; the bus is +-1.0), clip and convert
+            float fGain = nAmplitude / 32768.0f;
+
+            if (audioFormat == AUDIO_F32SYS)
+            {
+                kernels.softClip((float *)stream, bus, bufferLength, fGain, fClipThreshold);
+            }
+            else
+            {
+                kernels.toS16((Sint16 *)stream, bus, bufferLength, fGain, fClipThreshold, bDither ? mDitherState : NULL);
             }
         }
     };
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <string>
 
 #include "oscillator.h"
@@ -42,6 +44,7 @@ namespace wyaudio
         double off;  // time when note is deactivated
         bool active; // whether note is actively played
         int channel; // instrument channel, determined by sequencer
+        Uint32 handle; // from WY_MidiPlayer::noteOn, 0 = none
 
         Note()
         {
@@ -51,6 +54,7 @@ namespace wyaudio
             off = 0.0;
             active = false;
             channel = 0;
+            handle = 0;
         }
     };
 
@@ -92,7 +96,7 @@ namespace wyaudio
         INS_BELL
     };
 
-    std::string getInstrumentName(InstrumentType t)
+    const char *getInstrumentName(InstrumentType t)
     {
         switch (t)
         {
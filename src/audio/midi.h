@@ -11,6 +11,8 @@
 
 #include "audio.h"
 #include "instrument.h"
+#include "mixer.h"
+#include "voices.h"
 
 namespace wyaudio
 {
@@ -70,6 +72,12 @@ namespace wyaudio
         Uint32 nDuration = 0;
     };
 
+    struct WY_MidiTempo
+    {
+        Uint32 nTick = 0;  // absolute tick within the track the change appeared in
+        Uint32 nTempo = 0; // microseconds-per-quarternote
+    };
+
     struct WY_MidiTrack
     {
         // Uint16 nSequenceNum;
@@ -97,7 +105,9 @@ namespace wyaudio
     {
     public:
         std::vector<WY_MidiTrack> vecTracks;
+        std::vector<WY_MidiTempo> vecTempos;
         Uint32 nTempo = 0; // 24-bit (3-byte) of microseconds-per-quarternote (not miliseconds!)
+        Uint16 nTickDiv = 0; // ticks per quarternote
 
         WY_MidiFile()
         {
@@ -190,7 +200,7 @@ namespace wyaudio
             printf("\nnTrackChunks: %d", nTrackChunks);
 
             ifs.read((char *)&n16, sizeof(Uint16));
-            Uint16 nTickDiv = swap16(n16);
+            nTickDiv = swap16(n16);
             printf("\nnTickDiv: %d", nTickDiv); // usually 96
 
             // ==================================================
@@ -210,6 +220,7 @@ namespace wyaudio
                 // printf("\nnTrackLen: %d", nTrackLen);
 
                 bool bEndOfTrack = false;
+                Uint32 nTrackTick = 0;
                 Uint8 nPreviousStatus = 0;
 
                 vecTracks.push_back(WY_MidiTrack());
@@ -220,6 +231,7 @@ namespace wyaudio
                     Uint8 nStatus = 0;
 
                     nStatusTimeDelta = readVal();
+                    nTrackTick += nStatusTimeDelta;
                     nStatus = ifs.get();
 
                     // If running status, backtrack fstream by 1 byte
@@ -370,11 +382,16 @@ namespace wyaudio
                                 // printf(", End");
                                 break;
                             case MetaTempo:
-                                nTempo |= ifs.get() << 16;
-                                nTempo |= ifs.get() << 8;
-                                nTempo |= ifs.get() << 0;
+                            {
+                                Uint32 nEventTempo = 0;
+                                nEventTempo |= ifs.get() << 16;
+                                nEventTempo |= ifs.get() << 8;
+                                nEventTempo |= ifs.get() << 0;
+                                nTempo |= nEventTempo;
+                                vecTempos.push_back({nTrackTick, nEventTempo});
                                 // printf(", MetaTempo: %x", nTempo);
-                                break;
+                            }
+                            break;
                             case MetaSMPTEOffset:
                                 // printf(", MetaSMPTEOffset: %x %x %x %x %x", ifs.get(), ifs.get(), ifs.get(), ifs.get(), ifs.get());
                                 break;
@@ -466,15 +483,137 @@ namespace wyaudio
         std::vector<Note> vecNotes;
         SDL_mutex *muxNotes;
 
+        // One mixer channel per instrument; a note plays on the channel in Note::channel
         wyaudio::square chan0;
         wyaudio::square chan1;
         wyaudio::wave chan2;
         wyaudio::noise chan3;
+        WY_Mixer mMixer;
+
+        // Voice threads, see setVoiceThreads()
+        WY_VoicePool *mVoicePool = nullptr;
+        int nParallelVoices = 32;
+        double dVoiceDeadline = 0.5;
+        Uint32 nNextHandle = 1;
+
+        // Puts the voices on the pool, or returns false to render them here
+        bool renderVoicesParallel(int frames)
+        {
+            if (mVoicePool == nullptr || (int)vecNotes.size() < nParallelVoices || !mVoicePool->fits(mMixer, frames))
+            {
+                return false;
+            }
+
+            int capacity = 0;
+            WY_VoiceJob *jobs = mVoicePool->beginJobs(capacity);
+            if (jobs == NULL || (int)vecNotes.size() > capacity)
+            {
+                return false;
+            }
+
+            int count = 0;
+            for (auto &n : vecNotes)
+            {
+                if (n.channel >= 0 && n.channel < mMixer.getChannelCount())
+                {
+                    jobs[count++] = {n, mMixer.getChannel(n.channel).instrument, n.channel};
+                }
+            }
+
+            double dTimeDelta = 1.0 / (double)nSampleRate;
+            double dBlock = frames * dTimeDelta;
+            mVoicePool->render(mMixer, count, frames, dTime, dTimeDelta, dBlock * dVoiceDeadline);
+
+            return true;
+        }
+
+        // Adds the voices playing on each channel into mMixer's channel
+        // buffers, for frames frames starting at dTime. Called from the audio
+        // thread with muxNotes locked. Overwrite this to play other voices.
+        virtual void renderVoices(int frames)
+        {
+            double dTimeDelta = 1.0 / (double)nSampleRate;
+
+            if (!renderVoicesParallel(frames))
+            {
+                for (auto &n : vecNotes)
+                {
+                    if (n.channel < 0 || n.channel >= mMixer.getChannelCount())
+                    {
+                        continue;
+                    }
+
+                    Instrument *instrument = mMixer.getChannel(n.channel).instrument;
+                    float *out = mMixer.getChannelBuffer(n.channel);
+                    bool bNoteFinished = false;
+
+                    for (int f = 0; f < frames; f++)
+                    {
+                        out[f] += instrument->speak(dTime + f * dTimeDelta, n, bNoteFinished);
+                    }
+                }
+            }
+
+            // Released notes that have faded out by the end of the block.
+            // Checked here rather than per sample, so both paths agree.
+            double dEnd = dTime + frames * dTimeDelta;
+            for (auto &n : vecNotes)
+            {
+                if (n.channel < 0 || n.channel >= mMixer.getChannelCount())
+                {
+                    continue;
+                }
+
+                Instrument *instrument = mMixer.getChannel(n.channel).instrument;
+                if (n.off >= n.on && instrument->env.getAmplitude(dEnd, n.on, n.off) <= 0.0)
+                {
+                    n.active = false;
+                }
+            }
+
+            safe_remove<std::vector<wyaudio::Note>>(vecNotes, [](wyaudio::Note const &item) { return item.active; });
+        }
+
+        void renderBlock(float *bus, int frames)
+        {
+            double dTimeDelta = 1.0 / (double)nSampleRate;
+
+            if (SDL_LockMutex(muxNotes) != 0)
+            {
+                memset(bus, 0, frames * nChannels * sizeof(float));
+                dTime += frames * dTimeDelta;
+                return;
+            }
+
+            // In blocks the mixer has room for
+            for (int done = 0; done < frames;)
+            {
+                int block = SDL_min(frames - done, mMixer.getMaxFrames());
+
+                mMixer.begin(block);
+                renderVoices(block);
+                mMixer.mix(bus + done * nChannels, nChannels);
+
+                dTime += block * dTimeDelta;
+                done += block;
+            }
+
+            SDL_UnlockMutex(muxNotes);
+        }
 
     public:
-        WY_MidiPlayer()
+        WY_MidiPlayer() : mMixer(4)
         {
             muxNotes = SDL_CreateMutex();
+
+            // The two pulse channels a little apart, to give the mix some width
+            Instrument *instruments[4] = {&chan0, &chan1, &chan2, &chan3};
+            float pans[4] = {-0.3f, 0.3f, 0.0f, 0.0f};
+            for (int c = 0; c < 4; c++)
+            {
+                mMixer.getChannel(c).instrument = instruments[c];
+                mMixer.getChannel(c).fPan = pans[c];
+            }
         }
 
         ~WY_MidiPlayer()
@@ -485,6 +624,9 @@ namespace wyaudio
             }
             midiFiles.clear();
 
+            // Stop the audio thread from using the pool first
+            setVoiceThreads(0);
+
             vecNotes.clear();
             delete &vecNotes;
 
@@ -514,6 +656,7 @@ namespace wyaudio
 
                     // Add note to vector
                     vecNotes.emplace_back(n);
+                    markTrigger();
                 }
                 else
                 {
@@ -548,50 +691,145 @@ namespace wyaudio
             SDL_UnlockMutex(muxNotes);
         }
 
-        double getAudioSample()
+        // Starts a voice for a MIDI key (60 = middle C) on a mixer channel.
+        // Returns a handle for noteOff(), or 0 if it couldn't be started.
+        Uint32 noteOn(Uint8 key, int channel = 0)
         {
             if (SDL_LockMutex(muxNotes) != 0)
-                return 0.0;
+                return 0;
+
+            wyaudio::Note n;
+            n.id = key % 12;
+            n.octave = key / 12;
+            n.on = dTime;
+            n.off = dTime - 1.0; // before on: not released, even at dTime 0
+            n.channel = channel;
+            n.active = true;
+            n.handle = nNextHandle++;
+            if (nNextHandle == 0)
+            {
+                nNextHandle = 1;
+            }
 
-            double dMixedOutput = 0.0;
+            vecNotes.emplace_back(n);
+            markTrigger();
+
+            SDL_UnlockMutex(muxNotes);
+
+            return n.handle;
+        }
+
+        // Releases a voice from noteOn(); it is removed once its envelope ends
+        void noteOff(Uint32 handle)
+        {
+            if (handle == 0 || SDL_LockMutex(muxNotes) != 0)
+                return;
 
             for (auto &n : vecNotes)
             {
-                bool bNoteFinished = false;
-                double dSound = 0.0;
-
-                switch (n.channel)
+                if (n.handle == handle && n.off < n.on)
                 {
-                case 0:
-                    dSound = chan0.speak(dTime, n, bNoteFinished);
-                    break;
-                case 1:
-                    dSound = chan1.speak(dTime, n, bNoteFinished);
-                    break;
-                case 2:
-                    dSound = chan2.speak(dTime, n, bNoteFinished);
-                    break;
-                case 3:
-                    dSound = chan3.speak(dTime, n, bNoteFinished);
-                    break;
-                default:
-                    dSound = 0.0;
-                    break;
+                    n.off = dTime;
                 }
+            }
 
-                dMixedOutput += dSound;
+            SDL_UnlockMutex(muxNotes);
+        }
+
+        // Voices currently playing or fading out
+        int getVoiceCount()
+        {
+            return vecNotes.size();
+        }
 
-                if (bNoteFinished && n.off >= n.on)
+        // ==================================================
+        // Voice threads
+        // ==================================================
+
+        // Renders blocks with at least minVoices voices on threads worker
+        // threads plus the audio thread, for songs with more voices than one
+        // thread can keep up with. Workers that haven't finished within
+        // deadline (a fraction of the block's duration) are left behind and
+        // their voices rendered on the audio thread instead. 0 threads turns
+        // this off. Not available with emscripten. At most one thread per
+        // spare CPU core: more would only take turns with the audio thread.
+        void setVoiceThreads(int threads, int minVoices = 32, double deadline = 0.5)
+        {
+            threads = SDL_min(threads, SDL_GetCPUCount() - 1);
+
+            WY_VoicePool *pool = nullptr;
+            if (threads > 0)
+            {
+                pool = new WY_VoicePool(threads, mMixer.getChannelCount(), mMixer.getMaxFrames());
+                if (pool->getThreadCount() == 0)
                 {
-                    n.active = false;
+                    delete pool;
+                    pool = nullptr;
                 }
             }
 
-            safe_remove<std::vector<wyaudio::Note>>(vecNotes, [](wyaudio::Note const &item) { return item.active; });
+            SDL_LockAudioDevice(deviceId);
+            WY_VoicePool *old = mVoicePool;
+            mVoicePool = pool;
+            nParallelVoices = SDL_max(minVoices, 1);
+            dVoiceDeadline = deadline;
+            SDL_UnlockAudioDevice(deviceId);
 
-            SDL_UnlockMutex(muxNotes);
+            delete old;
+        }
+
+        int getVoiceThreads()
+        {
+            return mVoicePool != nullptr ? mVoicePool->getThreadCount() : 0;
+        }
+
+        // ==================================================
+        // Mixer
+        // ==================================================
+
+        // Volume of a channel, 1.0 = unchanged
+        void setChannelGain(int channel, float gain)
+        {
+            SDL_LockAudioDevice(deviceId);
+            mMixer.getChannel(channel).fGain = gain;
+            SDL_UnlockAudioDevice(deviceId);
+        }
 
-            return dMixedOutput;
+        // -1 = left, 0 = center, 1 = right
+        void setChannelPan(int channel, float pan)
+        {
+            SDL_LockAudioDevice(deviceId);
+            mMixer.getChannel(channel).fPan = pan;
+            SDL_UnlockAudioDevice(deviceId);
+        }
+
+        void setChannelMute(int channel, bool mute)
+        {
+            SDL_LockAudioDevice(deviceId);
+            mMixer.getChannel(channel).bMute = mute;
+            SDL_UnlockAudioDevice(deviceId);
+        }
+
+        bool isChannelMuted(int channel)
+        {
+            return mMixer.getChannel(channel).bMute;
+        }
+
+        // Replaces the mixer, e.g. to add group buses. Channels whose
+        // instrument isn't set keep the default one.
+        void setMixer(const WY_Mixer &mixer)
+        {
+            SDL_LockAudioDevice(deviceId);
+            Instrument *instruments[4] = {&chan0, &chan1, &chan2, &chan3};
+            mMixer = mixer;
+            for (int c = 0; c < mMixer.getChannelCount(); c++)
+            {
+                if (mMixer.getChannel(c).instrument == nullptr)
+                {
+                    mMixer.getChannel(c).instrument = instruments[c % 4];
+                }
+            }
+            SDL_UnlockAudioDevice(deviceId);
         }
     };
 } // namespace wyaudio
\ No newline at end of file
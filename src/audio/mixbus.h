@@ -0,0 +1,323 @@
+// Mix bus
+//
+// WY_Audio renders each buffer into a float32 bus (full scale = +-1.0) and
+// only converts to the device format at the end, so voices can sum past full
+// scale without wrapping around. Before the conversion the bus goes through a
+// soft clipper: untouched below the threshold, then bending smoothly towards
+// +-1.0 instead of hitting it hard.
+//
+// The master gain, the clip and the conversion to the device format are fused
+// into one kernel per format, so the bus is read once. The kernels run over
+// the whole buffer, so they are vectorized: AVX2 or SSE2 when the CPU has
+// them, picked once at runtime. A threshold of 1.0 or more turns the clip off.
+// The conversion can add TPDF dither (two random values subtracted, +-1 LSB),
+// which turns the rounding error of quiet signals into a little flat noise.
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <math.h>
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define WY_AUDIO_X86
+#include <immintrin.h>
+#endif
+
+#if defined(WY_AUDIO_X86) && (defined(__GNUC__) || defined(__clang__))
+#define WY_AUDIO_TARGET(isa) __attribute__((target(isa)))
+#else
+#define WY_AUDIO_TARGET(isa)
+#endif
+
+// Random state for the dither, one per SIMD lane
+#define WY_DITHER_LANES 8
+
+namespace wyaudio
+{
+    // Writes src * gain, soft clipped, as float32
+    typedef void (*WY_SoftClipKernel)(float *dst, const float *src, int count, float gain, float threshold);
+
+    // Writes src * gain, soft clipped, as S16. dither is WY_DITHER_LANES
+    // random states, or NULL for no dither
+    typedef void (*WY_ConvertKernel)(Sint16 *dst, const float *src, int count, float gain, float threshold, Uint32 *dither);
+
+    struct WY_MixKernels
+    {
+        WY_SoftClipKernel softClip;
+        WY_ConvertKernel toS16;
+    };
+
+    // ==================================================
+    // Scalar
+    // ==================================================
+
+    inline Uint32 xorshift(Uint32 &state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Above the threshold the excess is squashed by d / (1 + d), which starts
+    // with slope 1 (no kink) and never reaches 1.0
+    inline float softClipSample(float x, float threshold)
+    {
+        float a = fabsf(x);
+        if (a <= threshold || threshold >= 1.0f)
+        {
+            return x;
+        }
+
+        float knee = 1.0f - threshold;
+        float d = (a - threshold) / knee;
+        float y = threshold + knee * d / (1.0f + d);
+
+        return x < 0 ? -y : y;
+    }
+
+    inline Sint16 toS16Sample(float x, Uint32 *dither)
+    {
+        float v = x * 32767.0f;
+        if (dither != NULL)
+        {
+            Uint32 r = xorshift(dither[0]);
+            v += ((int)(r >> 16) - (int)(r & 0xFFFF)) * (1.0f / 65536.0f);
+        }
+
+        long s = lrintf(v);
+        return s > 32767 ? 32767 : s < -32768 ? -32768 : (Sint16)s;
+    }
+
+    void softClipScalar(float *dst, const float *src, int count, float gain, float threshold)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            dst[i] = softClipSample(src[i] * gain, threshold);
+        }
+    }
+
+    void toS16Scalar(Sint16 *dst, const float *src, int count, float gain, float threshold, Uint32 *dither)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            dst[i] = toS16Sample(softClipSample(src[i] * gain, threshold), dither);
+        }
+    }
+
+#ifdef WY_AUDIO_X86
+    // ==================================================
+    // SSE2
+    // ==================================================
+
+    struct WY_ClipSSE2
+    {
+        __m128 sign, t, knee, invKnee, one, zero;
+        bool bClip;
+    };
+
+    WY_AUDIO_TARGET("sse2")
+    inline WY_ClipSSE2 clipSetupSSE2(float threshold)
+    {
+        bool bClip = threshold < 1.0f;
+        float knee = bClip ? 1.0f - threshold : 1.0f;
+        return {_mm_set1_ps(-0.0f), _mm_set1_ps(threshold), _mm_set1_ps(knee), _mm_set1_ps(1.0f / knee), _mm_set1_ps(1.0f), _mm_setzero_ps(), bClip};
+    }
+
+    WY_AUDIO_TARGET("sse2")
+    inline __m128 clipSSE2(__m128 x, const WY_ClipSSE2 &c)
+    {
+        if (!c.bClip)
+        {
+            return x;
+        }
+
+        __m128 a = _mm_andnot_ps(c.sign, x);
+
+        // d is 0 below the threshold, which leaves y = a
+        __m128 d = _mm_mul_ps(_mm_max_ps(_mm_sub_ps(a, c.t), c.zero), c.invKnee);
+        __m128 y = _mm_add_ps(_mm_min_ps(a, c.t), _mm_div_ps(_mm_mul_ps(c.knee, d), _mm_add_ps(c.one, d)));
+
+        return _mm_or_ps(y, _mm_and_ps(c.sign, x));
+    }
+
+    WY_AUDIO_TARGET("sse2")
+    void softClipSSE2(float *dst, const float *src, int count, float gain, float threshold)
+    {
+        WY_ClipSSE2 clip = clipSetupSSE2(threshold);
+        __m128 g = _mm_set1_ps(gain);
+
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            _mm_storeu_ps(dst + i, clipSSE2(_mm_mul_ps(_mm_loadu_ps(src + i), g), clip));
+        }
+
+        softClipScalar(dst + i, src + i, count - i, gain, threshold);
+    }
+
+    WY_AUDIO_TARGET("sse2")
+    void toS16SSE2(Sint16 *dst, const float *src, int count, float gain, float threshold, Uint32 *dither)
+    {
+        WY_ClipSSE2 clip = clipSetupSSE2(threshold);
+        __m128 g = _mm_set1_ps(gain);
+        __m128 scale = _mm_set1_ps(32767.0f);
+        __m128 lsb = _mm_set1_ps(1.0f / 65536.0f);
+        __m128i low = _mm_set1_epi32(0xFFFF);
+        __m128i state = dither != NULL ? _mm_loadu_si128((const __m128i *)dither) : _mm_setzero_si128();
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128 a = _mm_mul_ps(clipSSE2(_mm_mul_ps(_mm_loadu_ps(src + i), g), clip), scale);
+            __m128 b = _mm_mul_ps(clipSSE2(_mm_mul_ps(_mm_loadu_ps(src + i + 4), g), clip), scale);
+
+            if (dither != NULL)
+            {
+                for (int half = 0; half < 2; half++)
+                {
+                    state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+                    state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+                    state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+
+                    __m128i diff = _mm_sub_epi32(_mm_srli_epi32(state, 16), _mm_and_si128(state, low));
+                    __m128 tpdf = _mm_mul_ps(_mm_cvtepi32_ps(diff), lsb);
+                    if (half == 0)
+                    {
+                        a = _mm_add_ps(a, tpdf);
+                    }
+                    else
+                    {
+                        b = _mm_add_ps(b, tpdf);
+                    }
+                }
+            }
+
+            // Round to nearest, then saturate to 16 bits
+            __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+            _mm_storeu_si128((__m128i *)(dst + i), packed);
+        }
+
+        if (dither != NULL)
+        {
+            _mm_storeu_si128((__m128i *)dither, state);
+        }
+
+        toS16Scalar(dst + i, src + i, count - i, gain, threshold, dither);
+    }
+
+    // ==================================================
+    // AVX2
+    // ==================================================
+
+    struct WY_ClipAVX2
+    {
+        __m256 sign, t, knee, invKnee, one, zero;
+        bool bClip;
+    };
+
+    WY_AUDIO_TARGET("avx2")
+    inline WY_ClipAVX2 clipSetupAVX2(float threshold)
+    {
+        bool bClip = threshold < 1.0f;
+        float knee = bClip ? 1.0f - threshold : 1.0f;
+        return {_mm256_set1_ps(-0.0f), _mm256_set1_ps(threshold), _mm256_set1_ps(knee), _mm256_set1_ps(1.0f / knee), _mm256_set1_ps(1.0f), _mm256_setzero_ps(), bClip};
+    }
+
+    WY_AUDIO_TARGET("avx2")
+    inline __m256 clipAVX2(__m256 x, const WY_ClipAVX2 &c)
+    {
+        if (!c.bClip)
+        {
+            return x;
+        }
+
+        __m256 a = _mm256_andnot_ps(c.sign, x);
+        __m256 d = _mm256_mul_ps(_mm256_max_ps(_mm256_sub_ps(a, c.t), c.zero), c.invKnee);
+        __m256 y = _mm256_add_ps(_mm256_min_ps(a, c.t), _mm256_div_ps(_mm256_mul_ps(c.knee, d), _mm256_add_ps(c.one, d)));
+
+        return _mm256_or_ps(y, _mm256_and_ps(c.sign, x));
+    }
+
+    WY_AUDIO_TARGET("avx2")
+    void softClipAVX2(float *dst, const float *src, int count, float gain, float threshold)
+    {
+        WY_ClipAVX2 clip = clipSetupAVX2(threshold);
+        __m256 g = _mm256_set1_ps(gain);
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            _mm256_storeu_ps(dst + i, clipAVX2(_mm256_mul_ps(_mm256_loadu_ps(src + i), g), clip));
+        }
+
+        softClipScalar(dst + i, src + i, count - i, gain, threshold);
+    }
+
+    WY_AUDIO_TARGET("avx2")
+    void toS16AVX2(Sint16 *dst, const float *src, int count, float gain, float threshold, Uint32 *dither)
+    {
+        WY_ClipAVX2 clip = clipSetupAVX2(threshold);
+        __m256 g = _mm256_set1_ps(gain);
+        __m256 scale = _mm256_set1_ps(32767.0f);
+        __m256 lsb = _mm256_set1_ps(1.0f / 65536.0f);
+        __m256i low = _mm256_set1_epi32(0xFFFF);
+        __m256i state = dither != NULL ? _mm256_loadu_si256((const __m256i *)dither) : _mm256_setzero_si256();
+
+        int i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m256 a = _mm256_mul_ps(clipAVX2(_mm256_mul_ps(_mm256_loadu_ps(src + i), g), clip), scale);
+            __m256 b = _mm256_mul_ps(clipAVX2(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), g), clip), scale);
+
+            if (dither != NULL)
+            {
+                for (int half = 0; half < 2; half++)
+                {
+                    state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 13));
+                    state = _mm256_xor_si256(state, _mm256_srli_epi32(state, 17));
+                    state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 5));
+
+                    __m256i diff = _mm256_sub_epi32(_mm256_srli_epi32(state, 16), _mm256_and_si256(state, low));
+                    __m256 tpdf = _mm256_mul_ps(_mm256_cvtepi32_ps(diff), lsb);
+                    if (half == 0)
+                    {
+                        a = _mm256_add_ps(a, tpdf);
+                    }
+                    else
+                    {
+                        b = _mm256_add_ps(b, tpdf);
+                    }
+                }
+            }
+
+            // packs works within 128-bit lanes; put the 4-sample groups back in order
+            __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+            packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256((__m256i *)(dst + i), packed);
+        }
+
+        if (dither != NULL)
+        {
+            _mm256_storeu_si256((__m256i *)dither, state);
+        }
+
+        toS16Scalar(dst + i, src + i, count - i, gain, threshold, dither);
+    }
+#endif
+
+    WY_MixKernels getMixKernels()
+    {
+#ifdef WY_AUDIO_X86
+        if (SDL_HasAVX2())
+        {
+            return {softClipAVX2, toS16AVX2};
+        }
+        if (SDL_HasSSE2())
+        {
+            return {softClipSSE2, toS16SSE2};
+        }
+#endif
+        return {softClipScalar, toS16Scalar};
+    }
+} // namespace wyaudio
@@ -0,0 +1,197 @@
+// Mixer
+//
+// Channel strips (gain, pan, mute) feeding either the master bus or a group
+// bus (gain, mute) that in turn feeds the master. Each strip has a mono
+// buffer that voices are rendered into for one block of frames; mix() then
+// pans the strips into stereo, sums them through their buses and writes
+// interleaved frames for the device.
+//
+//   mixer.begin(frames);
+//   ... add voices into mixer.getChannelBuffer(ch) ...
+//   mixer.mix(out, 2);
+//
+// All buffers are allocated up front for blocks of up to maxFrames frames,
+// so the audio callback never allocates; longer blocks go in several calls.
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "instrument.h"
+
+namespace wyaudio
+{
+    struct WY_ChannelStrip
+    {
+        float fGain = 1.0f;
+        float fPan = 0.0f; // -1 = left, 0 = center, 1 = right
+        bool bMute = false;
+        int nBus = -1; // group bus, or -1 for the master bus
+        Instrument *instrument = nullptr;
+    };
+
+    struct WY_MixBus
+    {
+        float fGain = 1.0f;
+        bool bMute = false;
+    };
+
+    class WY_Mixer
+    {
+        std::vector<WY_ChannelStrip> mStrips;
+        std::vector<WY_MixBus> mBuses;
+
+        int nMaxFrames;
+        int nFrames = 0;
+        std::vector<float> mChannelBuffers; // mono, nMaxFrames per strip
+        std::vector<float> mBusBuffers;     // stereo interleaved, per bus and then master
+
+        float *getBusBuffer(int bus)
+        {
+            return mBusBuffers.data() + bus * nMaxFrames * 2;
+        }
+
+        float *getMasterBuffer()
+        {
+            return getBusBuffer(mBuses.size());
+        }
+
+        // Adds mono into stereo with the given left/right gains
+        static void addPanned(float *stereo, const float *mono, int frames, float left, float right)
+        {
+            for (int f = 0; f < frames; f++)
+            {
+                stereo[f * 2] += mono[f] * left;
+                stereo[f * 2 + 1] += mono[f] * right;
+            }
+        }
+
+    public:
+        WY_Mixer(int channels = 4, int buses = 0, int maxFrames = 1024)
+        {
+            nMaxFrames = maxFrames;
+            mStrips.resize(channels);
+            mBuses.resize(buses);
+
+            mChannelBuffers.resize(channels * maxFrames);
+            mBusBuffers.resize((buses + 1) * maxFrames * 2);
+        }
+
+        // ==================================================
+        // Getters
+        // ==================================================
+
+        int getChannelCount()
+        {
+            return mStrips.size();
+        }
+
+        int getBusCount()
+        {
+            return mBuses.size();
+        }
+
+        int getMaxFrames()
+        {
+            return nMaxFrames;
+        }
+
+        WY_ChannelStrip &getChannel(int channel)
+        {
+            return mStrips[channel];
+        }
+
+        WY_MixBus &getBus(int bus)
+        {
+            return mBuses[bus];
+        }
+
+        // The channel's mono buffer for the current block; add voices into it
+        float *getChannelBuffer(int channel)
+        {
+            return mChannelBuffers.data() + channel * nMaxFrames;
+        }
+
+        // ==================================================
+        // Methods
+        // ==================================================
+
+        // Starts a block of frames (at most getMaxFrames()) with silent channels
+        void begin(int frames)
+        {
+            nFrames = SDL_min(frames, nMaxFrames);
+
+            for (size_t c = 0; c < mStrips.size(); c++)
+            {
+                memset(getChannelBuffer(c), 0, nFrames * sizeof(float));
+            }
+        }
+
+        // Mixes the block into out, interleaved with outChannels channels.
+        // Stereo goes to the first two; mono gets the sum.
+        void mix(float *out, int outChannels)
+        {
+            for (size_t b = 0; b <= mBuses.size(); b++)
+            {
+                memset(getBusBuffer(b), 0, nFrames * 2 * sizeof(float));
+            }
+
+            for (size_t c = 0; c < mStrips.size(); c++)
+            {
+                WY_ChannelStrip &strip = mStrips[c];
+                if (strip.bMute || strip.fGain == 0.0f)
+                {
+                    continue;
+                }
+
+                // Constant power: a centered channel is -3dB on each side
+                float angle = (SDL_min(SDL_max(strip.fPan, -1.0f), 1.0f) + 1.0f) * (float)M_PI / 4.0f;
+                float *target = strip.nBus >= 0 && strip.nBus < (int)mBuses.size() ? getBusBuffer(strip.nBus) : getMasterBuffer();
+
+                addPanned(target, getChannelBuffer(c), nFrames, strip.fGain * cosf(angle), strip.fGain * sinf(angle));
+            }
+
+            float *master = getMasterBuffer();
+            for (size_t b = 0; b < mBuses.size(); b++)
+            {
+                if (mBuses[b].bMute)
+                {
+                    continue;
+                }
+
+                float gain = mBuses[b].fGain;
+                float *bus = getBusBuffer(b);
+                for (int i = 0; i < nFrames * 2; i++)
+                {
+                    master[i] += bus[i] * gain;
+                }
+            }
+
+            if (outChannels == 2)
+            {
+                memcpy(out, master, nFrames * 2 * sizeof(float));
+            }
+            else if (outChannels == 1)
+            {
+                // Undo the -3dB of the pan law, so a centered channel comes out at its gain
+                for (int f = 0; f < nFrames; f++)
+                {
+                    out[f] = (master[f * 2] + master[f * 2 + 1]) * (float)M_SQRT1_2;
+                }
+            }
+            else
+            {
+                for (int f = 0; f < nFrames; f++)
+                {
+                    float *frame = out + f * outChannels;
+                    frame[0] = master[f * 2];
+                    frame[1] = master[f * 2 + 1];
+                    memset(frame + 2, 0, (outChannels - 2) * sizeof(float));
+                }
+            }
+        }
+    };
+} // namespace wyaudio
@@ -0,0 +1,260 @@
+// Baked song format
+//
+// A pre-converted, flat binary version of a MIDI file that the player can use
+// as-is: no event parsing, no note pairing and no per-note allocation at load.
+// Produce it with demos/midi-bake.cpp from any .mid that WY_MidiFile can read.
+//
+// Layout (host byte order, which is little-endian on all supported targets;
+// every block 4-byte aligned):
+//
+//   WY_SongHeader
+//   WY_SongTempo[nTempoCount]  tempo map, sorted by tick
+//   WY_SongTrack[nTrackCount]  per-track note range and instrument
+//   WY_SongNote[nNoteCount]    notes of all tracks, grouped by track, sorted by start time
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <fstream>
+
+#define WY_SONG_MAGIC SDL_FOURCC('W', 'Y', 'S', 'G')
+#define WY_SONG_VERSION 1
+
+namespace wyaudio
+{
+    struct WY_SongHeader
+    {
+        Uint32 nMagic;      // WY_SONG_MAGIC, i.e. "WYSG"
+        Uint16 nVersion;    // WY_SONG_VERSION
+        Uint16 nTickDiv;    // ticks per quarternote of the source file
+        Uint32 nLength;     // song length in ms (end of the last note)
+        Uint32 nTempoCount; // entries in the tempo map
+        Uint32 nTempoOffset;
+        Uint32 nTrackCount;
+        Uint32 nTrackOffset;
+        Uint32 nNoteCount; // notes in all tracks
+        Uint32 nNoteOffset;
+    };
+
+    struct WY_SongTempo
+    {
+        Uint32 nTick;  // absolute tick
+        Uint32 nTime;  // absolute time in ms
+        Uint32 nTempo; // microseconds-per-quarternote
+    };
+
+    struct WY_SongTrack
+    {
+        Uint32 nFirstNote; // index into the note array
+        Uint32 nNoteCount;
+        Uint8 nInstrument; // instrument (player channel) assigned to this track
+        Uint8 nReserved[3];
+    };
+
+    struct WY_SongNote
+    {
+        Uint32 nStartTime; // absolute time in ms
+        Uint32 nDuration;  // in ms
+        Uint8 nKey;
+        Uint8 nVelocity;
+        Uint8 nReserved[2];
+
+        // Absolute start time in samples, for sample-accurate scheduling
+        Uint32 getStartSample(int nSampleRate) const
+        {
+            return (Uint32)((Uint64)nStartTime * nSampleRate / 1000);
+        }
+
+        Uint32 getDurationSamples(int nSampleRate) const
+        {
+            return (Uint32)((Uint64)nDuration * nSampleRate / 1000);
+        }
+    };
+
+    // Read-only view over a baked song.
+    //
+    // The song either owns a single buffer read from disk in one go (load), or
+    // points at memory the caller already has, e.g. a memory-mapped file or an
+    // array compiled into the binary (attach). Either way every accessor
+    // returns pointers straight into that memory.
+    class WY_BakedSong
+    {
+        Uint8 *mOwnedData = nullptr;
+        const Uint8 *mData = nullptr;
+        size_t mSize = 0;
+
+        const WY_SongHeader *mHeader = nullptr;
+        const WY_SongTempo *mTempos = nullptr;
+        const WY_SongTrack *mTracks = nullptr;
+        const WY_SongNote *mNotes = nullptr;
+
+        // Checks that a block of `count` items of `itemSize` bytes at `offset` fits in the buffer
+        bool fits(Uint32 offset, Uint32 count, size_t itemSize)
+        {
+            return offset % 4 == 0 && offset <= mSize && (Uint64)count * itemSize <= mSize - offset;
+        }
+
+        void detach()
+        {
+            mData = nullptr;
+            mSize = 0;
+            mHeader = nullptr;
+            mTempos = nullptr;
+            mTracks = nullptr;
+            mNotes = nullptr;
+        }
+
+        // Points all views into `data` after validating the header and block bounds
+        bool bind(const void *data, size_t size)
+        {
+            mData = (const Uint8 *)data;
+            mSize = size;
+
+            if (mData == nullptr || (uintptr_t)mData % 4 != 0 || mSize < sizeof(WY_SongHeader))
+            {
+                detach();
+                return false;
+            }
+
+            const WY_SongHeader *header = (const WY_SongHeader *)mData;
+            if (header->nMagic != WY_SONG_MAGIC || header->nVersion != WY_SONG_VERSION ||
+                !fits(header->nTempoOffset, header->nTempoCount, sizeof(WY_SongTempo)) ||
+                !fits(header->nTrackOffset, header->nTrackCount, sizeof(WY_SongTrack)) ||
+                !fits(header->nNoteOffset, header->nNoteCount, sizeof(WY_SongNote)))
+            {
+                detach();
+                return false;
+            }
+
+            mHeader = header;
+            mTempos = (const WY_SongTempo *)(mData + header->nTempoOffset);
+            mTracks = (const WY_SongTrack *)(mData + header->nTrackOffset);
+            mNotes = (const WY_SongNote *)(mData + header->nNoteOffset);
+
+            // Validate track ranges once so getNotes never needs to
+            for (Uint32 i = 0; i < header->nTrackCount; i++)
+            {
+                if ((Uint64)mTracks[i].nFirstNote + mTracks[i].nNoteCount > header->nNoteCount)
+                {
+                    detach();
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+    public:
+        WY_BakedSong() {}
+
+        WY_BakedSong(const char *file)
+        {
+            load(file);
+        }
+
+        ~WY_BakedSong()
+        {
+            unload();
+        }
+
+        // Owns its buffer; copies would free it twice
+        WY_BakedSong(const WY_BakedSong &) = delete;
+        WY_BakedSong &operator=(const WY_BakedSong &) = delete;
+
+        // Loads a baked song file into a single owned buffer
+        bool load(const char *file)
+        {
+            unload();
+
+            std::ifstream ifs;
+            ifs.open(file, std::fstream::in | std::ios::binary | std::ios::ate);
+            if (!ifs.is_open())
+            {
+                printf("\nFailed to open file: %s\n", file);
+                return false;
+            }
+
+            size_t nSize = (size_t)ifs.tellg();
+            ifs.seekg(0, std::ios::beg);
+
+            mOwnedData = new Uint8[nSize];
+            if (!ifs.read((char *)mOwnedData, nSize))
+            {
+                printf("\nFailed to read file: %s\n", file);
+                unload();
+                return false;
+            }
+
+            if (!bind(mOwnedData, nSize))
+            {
+                printf("\nInvalid baked song: %s\n", file);
+                unload();
+                return false;
+            }
+
+            return true;
+        }
+
+        // Uses caller-owned memory directly; it must stay valid (and 4-byte aligned)
+        // for as long as this song is in use.
+        bool attach(const void *data, size_t size)
+        {
+            unload();
+            return bind(data, size);
+        }
+
+        void unload()
+        {
+            detach();
+
+            delete[] mOwnedData;
+            mOwnedData = nullptr;
+        }
+
+        // ==================================================
+        // Getters
+        // ==================================================
+
+        bool isLoaded()
+        {
+            return mHeader != nullptr;
+        }
+
+        int getBPM()
+        {
+            Uint32 nTempo = getTempoCount() > 0 ? mTempos[0].nTempo : 0;
+            return nTempo == 0 ? 120 : (60 * 1000 * 1000) / nTempo;
+        }
+
+        Uint32 getLength()
+        {
+            return isLoaded() ? mHeader->nLength : 0;
+        }
+
+        Uint32 getTempoCount()
+        {
+            return isLoaded() ? mHeader->nTempoCount : 0;
+        }
+
+        const WY_SongTempo *getTempos()
+        {
+            return mTempos;
+        }
+
+        Uint32 getTrackCount()
+        {
+            return isLoaded() ? mHeader->nTrackCount : 0;
+        }
+
+        const WY_SongTrack &getTrack(Uint32 track)
+        {
+            return mTracks[track];
+        }
+
+        // Returns the first note of a track; use getTrack(track).nNoteCount for its length
+        const WY_SongNote *getNotes(Uint32 track)
+        {
+            return mNotes + mTracks[track].nFirstNote;
+        }
+    };
+} // namespace wyaudio
@@ -0,0 +1,361 @@
+// Voice threads
+//
+// Renders a block of voices on a small pool of worker threads, for songs
+// with more voices than the audio thread can render alone. The voices are
+// copied into a job list, split into chunks of WY_VOICE_CHUNK, and the
+// workers and the audio thread itself take chunks until none are left.
+// Workers add their voices into their own scratch channel buffers, which are
+// summed into the mixer afterwards.
+//
+// The audio thread can't wait long: if a worker hasn't finished by the
+// deadline (e.g. the OS didn't schedule it), the audio thread renders that
+// worker's chunks again itself and ignores its scratch. A worker that is
+// still stuck two blocks later holds on to its job list, and the block is
+// rendered serially instead.
+//
+// Nothing here allocates after construction. Workers only read the job list
+// and write their own scratch, so the voices can change between blocks.
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <memory>
+#include <string.h>
+#include <vector>
+
+#include "instrument.h"
+#include "mixer.h"
+
+#define WY_VOICE_CHUNK 8
+
+namespace wyaudio
+{
+    struct WY_VoiceJob
+    {
+        Note note;
+        Instrument *instrument;
+        int channel;
+    };
+
+    struct WY_VoicePoolStats
+    {
+        Uint64 nBlocks = 0;     // blocks rendered on the pool
+        Uint64 nLateChunks = 0; // chunks the audio thread re-rendered after the deadline
+        Uint64 nBusyBlocks = 0; // blocks rendered serially because a worker was still stuck
+    };
+
+    int voiceWorkerThread(void *data);
+
+    class WY_VoicePool
+    {
+        struct Worker
+        {
+            WY_VoicePool *pool;
+            int index;
+            SDL_Thread *thread = NULL;
+            SDL_sem *sem = NULL;
+            std::vector<float> scratch; // channels * maxFrames, same layout as the mixer's channel buffers
+            std::atomic<Uint32> nActive{0}; // generation being worked on
+            std::atomic<Uint32> nDone{0};   // last generation finished
+        };
+
+        // Two job lists, used by alternate generations
+        struct JobSet
+        {
+            std::vector<WY_VoiceJob> jobs;
+            std::unique_ptr<std::atomic<Uint64>[]> owners; // per chunk: generation << 32 | worker + 1 (0 = audio thread)
+            int nCount = 0;
+            int nChunks = 0;
+            int nFrames = 0;
+            double dTime = 0.0;
+            double dTimeDelta = 0.0;
+        };
+
+        std::vector<std::unique_ptr<Worker>> mWorkers;
+        JobSet mSets[2];
+        int nChannels;
+        int nMaxFrames;
+        int nMaxVoices;
+
+        Uint32 nGeneration = 0;
+        std::atomic<Uint64> nClaim{0}; // generation << 32 | next chunk
+        std::atomic<bool> bQuit{false};
+        WY_VoicePoolStats mStats;
+
+        // Takes the next chunk of this generation, if any are left
+        bool claim(Uint32 generation, int nChunks, int &chunk)
+        {
+            Uint64 claim = nClaim.load();
+            while ((Uint32)(claim >> 32) == generation && (int)(claim & 0xFFFFFFFF) < nChunks)
+            {
+                if (nClaim.compare_exchange_weak(claim, claim + 1))
+                {
+                    chunk = claim & 0xFFFFFFFF;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        static void renderChunk(const JobSet &set, int chunk, float *buffers, int stride)
+        {
+            int first = chunk * WY_VOICE_CHUNK;
+            int last = SDL_min(first + WY_VOICE_CHUNK, set.nCount);
+
+            for (int j = first; j < last; j++)
+            {
+                const WY_VoiceJob &job = set.jobs[j];
+                float *out = buffers + job.channel * stride;
+                bool bNoteFinished = false;
+
+                for (int f = 0; f < set.nFrames; f++)
+                {
+                    out[f] += job.instrument->speak(set.dTime + f * set.dTimeDelta, job.note, bNoteFinished);
+                }
+            }
+        }
+
+    public:
+        WY_VoicePool(int threads, int channels, int maxFrames, int maxVoices = 1024)
+        {
+            nChannels = channels;
+            nMaxFrames = maxFrames;
+            nMaxVoices = maxVoices;
+
+            for (JobSet &set : mSets)
+            {
+                set.jobs.resize(maxVoices);
+                int chunks = (maxVoices + WY_VOICE_CHUNK - 1) / WY_VOICE_CHUNK;
+                set.owners.reset(new std::atomic<Uint64>[chunks]);
+                for (int c = 0; c < chunks; c++)
+                {
+                    set.owners[c] = 0;
+                }
+            }
+
+#ifdef __EMSCRIPTEN__
+            threads = 0;
+#endif
+
+            for (int i = 0; i < threads; i++)
+            {
+                Worker *worker = new Worker();
+                worker->pool = this;
+                worker->index = i;
+                worker->scratch.resize(channels * maxFrames);
+                worker->sem = SDL_CreateSemaphore(0);
+                worker->thread = SDL_CreateThread(voiceWorkerThread, "WY_VoicePool", worker);
+                if (worker->thread == NULL)
+                {
+                    SDL_Log("Unable to create voice thread! SDL_Error: %s\n", SDL_GetError());
+                    SDL_DestroySemaphore(worker->sem);
+                    delete worker;
+                    break;
+                }
+                mWorkers.emplace_back(worker);
+            }
+        }
+
+        ~WY_VoicePool()
+        {
+            bQuit = true;
+            for (auto &worker : mWorkers)
+            {
+                SDL_SemPost(worker->sem);
+            }
+            for (auto &worker : mWorkers)
+            {
+                SDL_WaitThread(worker->thread, NULL);
+                SDL_DestroySemaphore(worker->sem);
+            }
+        }
+
+        // ==================================================
+        // Getters
+        // ==================================================
+
+        int getThreadCount()
+        {
+            return mWorkers.size();
+        }
+
+        // Only read from the audio thread, or with the audio device locked
+        const WY_VoicePoolStats &getStats()
+        {
+            return mStats;
+        }
+
+        // ==================================================
+        // Methods
+        // ==================================================
+
+        // The job list to fill for the next render(), with room for capacity
+        // voices. NULL if a stuck worker still reads it; render serially then.
+        WY_VoiceJob *beginJobs(int &capacity)
+        {
+            Uint32 next = nGeneration + 1;
+            for (auto &worker : mWorkers)
+            {
+                Uint32 active = worker->nActive.load();
+                if (active != worker->nDone.load() && (active & 1) == (next & 1))
+                {
+                    mStats.nBusyBlocks++;
+                    return NULL;
+                }
+            }
+
+            capacity = nMaxVoices;
+            return mSets[next & 1].jobs.data();
+        }
+
+        // Whether render() can take a block of this shape
+        bool fits(WY_Mixer &mixer, int frames)
+        {
+            return !mWorkers.empty() && mixer.getChannelCount() <= nChannels && frames <= nMaxFrames && mixer.getMaxFrames() == nMaxFrames;
+        }
+
+        // Renders the first count jobs from beginJobs() for frames frames
+        // starting at time, adding them into the mixer's channel buffers.
+        // Gives up on workers after deadline seconds.
+        void render(WY_Mixer &mixer, int count, int frames, double time, double timeDelta, double deadline)
+        {
+            Uint64 start = SDL_GetPerformanceCounter();
+            Uint64 end = start + (Uint64)(deadline * SDL_GetPerformanceFrequency());
+
+            Uint32 generation = ++nGeneration;
+            JobSet &set = mSets[generation & 1];
+            set.nCount = count;
+            set.nChunks = (count + WY_VOICE_CHUNK - 1) / WY_VOICE_CHUNK;
+            set.nFrames = frames;
+            set.dTime = time;
+            set.dTimeDelta = timeDelta;
+
+            nClaim.store((Uint64)generation << 32);
+            for (auto &worker : mWorkers)
+            {
+                SDL_SemPost(worker->sem);
+            }
+
+            // Help out, straight into the mixer
+            float *buffers = mixer.getChannelBuffer(0);
+            int chunk;
+            while (claim(generation, set.nChunks, chunk))
+            {
+                set.owners[chunk].store((Uint64)generation << 32);
+                renderChunk(set, chunk, buffers, nMaxFrames);
+            }
+
+            // Wait for the workers' chunks, up to the deadline
+            Uint64 doneMask = 0;
+            while (true)
+            {
+                doneMask = 0;
+                for (size_t w = 0; w < mWorkers.size(); w++)
+                {
+                    doneMask |= (Uint64)(mWorkers[w]->nDone.load() == generation) << w;
+                }
+
+                bool bComplete = true;
+                for (int c = 0; c < set.nChunks && bComplete; c++)
+                {
+                    Uint64 owner = set.owners[c].load();
+                    int w = (int)(owner & 0xFFFFFFFF) - 1;
+                    bComplete = (Uint32)(owner >> 32) == generation && (w < 0 || (doneMask >> w) & 1);
+                }
+
+                if (bComplete || SDL_GetPerformanceCounter() >= end)
+                {
+                    break;
+                }
+            }
+
+            // Sum the finished workers' scratch
+            Uint64 usedMask = 0;
+            for (int c = 0; c < set.nChunks; c++)
+            {
+                Uint64 owner = set.owners[c].load();
+                int w = (int)(owner & 0xFFFFFFFF) - 1;
+                if ((Uint32)(owner >> 32) == generation && w >= 0 && (doneMask >> w) & 1)
+                {
+                    usedMask |= (Uint64)1 << w;
+                }
+                else if ((Uint32)(owner >> 32) != generation || w >= 0)
+                {
+                    // Late: its worker is still on it (or hasn't even said it took it)
+                    renderChunk(set, c, buffers, nMaxFrames);
+                    mStats.nLateChunks++;
+                }
+            }
+
+            for (size_t w = 0; w < mWorkers.size(); w++)
+            {
+                if ((usedMask >> w) & 1)
+                {
+                    const float *scratch = mWorkers[w]->scratch.data();
+                    for (int c = 0; c < mixer.getChannelCount(); c++)
+                    {
+                        float *out = mixer.getChannelBuffer(c);
+                        const float *in = scratch + c * nMaxFrames;
+                        for (int f = 0; f < frames; f++)
+                        {
+                            out[f] += in[f];
+                        }
+                    }
+                }
+            }
+
+            mStats.nBlocks++;
+        }
+
+        // Used by the worker threads. Do not call this.
+        void work(Worker *worker)
+        {
+            SDL_SetThreadPriority(SDL_THREAD_PRIORITY_TIME_CRITICAL);
+
+            while (true)
+            {
+                SDL_SemWait(worker->sem);
+                if (bQuit)
+                {
+                    break;
+                }
+
+                Uint32 generation = nClaim.load() >> 32;
+                worker->nActive.store(generation);
+
+                const JobSet &set = mSets[generation & 1];
+                bool bCleared = false;
+                int chunk;
+                while (claim(generation, set.nChunks, chunk))
+                {
+                    set.owners[chunk].store((Uint64)generation << 32 | (worker->index + 1));
+
+                    if (!bCleared)
+                    {
+                        for (int c = 0; c < nChannels; c++)
+                        {
+                            memset(worker->scratch.data() + c * nMaxFrames, 0, set.nFrames * sizeof(float));
+                        }
+                        bCleared = true;
+                    }
+
+                    renderChunk(set, chunk, worker->scratch.data(), nMaxFrames);
+                }
+
+                worker->nDone.store(generation);
+            }
+        }
+
+        friend int voiceWorkerThread(void *data);
+    };
+
+    // SDL threads only take plain functions, hence the intermediary
+    int voiceWorkerThread(void *data)
+    {
+        auto *worker = static_cast<WY_VoicePool::Worker *>(data);
+        worker->pool->work(worker);
+        return 0;
+    }
+} // namespace wyaudio
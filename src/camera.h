@@ -0,0 +1,122 @@
+// Camera
+//
+// Maps world coordinates to the game screen. The world point at the camera's
+// position is drawn at the top-left corner of the screen, and everything is
+// scaled by zoom (2.0 draws the world twice as big). Game code keeps its
+// objects in world coordinates and uses getView() to ask which part of the
+// world is on screen, e.g. for WY_SpatialHash::query or WY_Tilemap::draw.
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <cmath>
+
+class WY_Camera
+{
+    int mViewW, mViewH; // game screen size, in game pixels
+    double dX = 0.0;
+    double dY = 0.0;
+    double dZoom = 1.0;
+
+public:
+    WY_Camera(int viewW, int viewH)
+    {
+        mViewW = viewW;
+        mViewH = viewH;
+    }
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    double getX()
+    {
+        return dX;
+    }
+
+    double getY()
+    {
+        return dY;
+    }
+
+    double getZoom()
+    {
+        return dZoom;
+    }
+
+    // Part of the world on screen, rounded outwards to whole pixels
+    SDL_Rect getView()
+    {
+        int x0 = (int)std::floor(dX);
+        int y0 = (int)std::floor(dY);
+        int x1 = (int)std::ceil(dX + mViewW / dZoom);
+        int y1 = (int)std::ceil(dY + mViewH / dZoom);
+
+        return {x0, y0, x1 - x0, y1 - y0};
+    }
+
+    // ==================================================
+    // Setters
+    // ==================================================
+
+    void setPosition(double x, double y)
+    {
+        dX = x;
+        dY = y;
+    }
+
+    void move(double dx, double dy)
+    {
+        dX += dx;
+        dY += dy;
+    }
+
+    // Puts the world point x, y in the middle of the screen
+    void centerOn(double x, double y)
+    {
+        dX = x - mViewW / dZoom / 2.0;
+        dY = y - mViewH / dZoom / 2.0;
+    }
+
+    // Zooms around the middle of the screen
+    void setZoom(double zoom)
+    {
+        if (zoom <= 0.0)
+        {
+            return;
+        }
+
+        double cx = dX + mViewW / dZoom / 2.0;
+        double cy = dY + mViewH / dZoom / 2.0;
+        dZoom = zoom;
+        centerOn(cx, cy);
+    }
+
+    void setViewSize(int w, int h)
+    {
+        mViewW = w;
+        mViewH = h;
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    // Screen rect for a world rect. Edges are converted separately, so rects
+    // that touch in the world still touch on screen at any zoom.
+    SDL_Rect toScreen(const SDL_Rect &world)
+    {
+        int x0 = (int)std::floor((world.x - dX) * dZoom);
+        int y0 = (int)std::floor((world.y - dY) * dZoom);
+        int x1 = (int)std::floor((world.x + world.w - dX) * dZoom);
+        int y1 = (int)std::floor((world.y + world.h - dY) * dZoom);
+
+        return {x0, y0, x1 - x0, y1 - y0};
+    }
+
+    // World point under a screen point, e.g. the mouse
+    SDL_Point toWorld(int x, int y)
+    {
+        return {(int)std::floor(dX + x / dZoom), (int)std::floor(dY + y / dZoom)};
+    }
+};
@@ -0,0 +1,139 @@
+// Event buffer
+//
+// Holds every SDL event that arrived since the last frame. Wyngine drains the
+// whole SDL queue into it once per frame (in bulk, with SDL_PeepEvents), then
+// WY_Keyboard, WY_IO and game code iterate it:
+//
+//   for (const SDL_Event &event : *events) { ... }
+//
+// so a burst of input is handled in the frame it arrives in instead of one
+// event per frame. The storage is reused between frames and only grows if a
+// frame brings more events than ever before.
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <vector>
+
+struct WY_EventStats
+{
+    int nEvents = 0;         // events drained in the last frame
+    int nMaxEvents = 0;      // most events drained in a single frame, i.e. the deepest the queue got
+    Uint64 nTotalEvents = 0; // since start
+};
+
+class WY_EventBuffer
+{
+    std::vector<SDL_Event> mEvents;
+    int nCount = 0;
+    WY_EventStats mStats;
+
+public:
+    WY_EventBuffer(int capacity = 256)
+    {
+        mEvents.resize(capacity);
+    }
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    int size() const
+    {
+        return nCount;
+    }
+
+    bool empty() const
+    {
+        return nCount == 0;
+    }
+
+    const SDL_Event &operator[](int i) const
+    {
+        return mEvents[i];
+    }
+
+    const SDL_Event *begin() const
+    {
+        return mEvents.data();
+    }
+
+    const SDL_Event *end() const
+    {
+        return mEvents.data() + nCount;
+    }
+
+    // Whether any event of this type arrived this frame
+    bool has(Uint32 type) const
+    {
+        for (int i = 0; i < nCount; i++)
+        {
+            if (mEvents[i].type == type)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    const WY_EventStats &getStats()
+    {
+        return mStats;
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    // Replaces the buffer's contents with every pending SDL event.
+    // Returns how many there were.
+    int poll()
+    {
+        SDL_PumpEvents();
+
+        nCount = 0;
+        while (true)
+        {
+            int room = mEvents.size() - nCount;
+            int got = SDL_PeepEvents(mEvents.data() + nCount, room, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+            if (got < 0)
+            {
+                SDL_Log("Unable to read events! SDL_Error: %s\n", SDL_GetError());
+                break;
+            }
+
+            nCount += got;
+            if (got < room)
+            {
+                break;
+            }
+
+            // Full: more may be waiting
+            mEvents.resize(mEvents.size() * 2);
+        }
+
+        mStats.nEvents = nCount;
+        mStats.nMaxEvents = std::max(mStats.nMaxEvents, nCount);
+        mStats.nTotalEvents += nCount;
+
+        return nCount;
+    }
+
+    // Adds an event to this frame's buffer (e.g. synthesized input)
+    void push(const SDL_Event &event)
+    {
+        if (nCount == (int)mEvents.size())
+        {
+            mEvents.resize(mEvents.size() * 2);
+        }
+
+        mEvents[nCount++] = event;
+    }
+
+    void clear()
+    {
+        nCount = 0;
+    }
+};
@@ -2,11 +2,26 @@
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
+#include <algorithm>
+#include <functional>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include "framebuffer.h"
+
+// SDL_RenderGeometry draws a whole line of text in one call
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+#define WY_FONT_GEOMETRY
+#endif
 
 class WY_MonoFont
 {
+    friend class WY_TextBlock;
+
     SDL_Texture *mTexture = nullptr;
+    const WY_Bitmap *mBitmap = nullptr; // glyphs for the software renderer
+    SDL_Rect mSheet{0, 0, 0, 0}; // glyph area of the texture, e.g. an atlas sub-rect
     SDL_Rect mBound{0, 0, 0, 0};
     SDL_Rect mDest{0, 0, 0, 0};
     SDL_Rect mChars[256];
@@ -15,25 +30,57 @@ class WY_MonoFont
     int mCurrX, mCurrY;
     bool mDebug;
 
+    // Laid out text, reused for as long as the same text is printed in the same bound
+    struct Layout
+    {
+        size_t key; // hashLayout(text, bound)
+        std::string text;
+        SDL_Rect bound;
+        std::vector<SDL_Rect> src, dst;
+        std::vector<int> chars; // index in text of each glyph
+#ifdef WY_FONT_GEOMETRY
+        std::vector<SDL_Vertex> vertices; // 4 per glyph
+#endif
+        Uint32 nLastUsed;
+    };
+
+    std::vector<Layout> mLayouts;
+    size_t mLayoutCapacity = 32;
+    Uint32 mPrintCount = 0;
+    int mTexW = 1, mTexH = 1;
+#ifdef WY_FONT_GEOMETRY
+    std::vector<int> mIndices; // 6 per glyph, shared by all layouts
+#endif
+
     void buildFonts()
     {
-        int texW, texH;
-        SDL_QueryTexture(mTexture, NULL, NULL, &texW, &texH);
+        if (mSheet.w == 0 || mSheet.h == 0)
+        {
+            mSheet.x = 0;
+            mSheet.y = 0;
+            SDL_QueryTexture(mTexture, NULL, NULL, &mSheet.w, &mSheet.h);
+        }
+
+        int texW = mSheet.w;
+        if (mTexture != nullptr)
+        {
+            SDL_QueryTexture(mTexture, NULL, NULL, &mTexW, &mTexH);
+        }
 
         // Assumes font spritesheet uses ascii layout
         for (int i = 0; i < 256; i++)
         {
             mChars[i] = {
-                (i * mFontSize) % texW,
-                (i * mFontSize / texW) * mFontSize,
+                mSheet.x + (i * mFontSize) % texW,
+                mSheet.y + (i * mFontSize / texW) * mFontSize,
                 mFontSize,
                 mFontSize};
         }
     }
 
-    int getFullAscii(std::string text, int index)
+    int getFullAscii(std::string_view text, int index)
     {
-        if (index < 0 || index >= text.length())
+        if (index < 0 || index >= (int)text.length())
         {
             return (unsigned char)' ';
         }
@@ -41,15 +88,171 @@ class WY_MonoFont
         return (unsigned char)text[index];
     }
 
-    int getMiniAscii(std::string text, int index)
+    int getMiniAscii(std::string_view text, int index)
     {
-        if (index < 0 || index >= text.length())
+        if (index < 0 || index >= (int)text.length())
         {
             return (unsigned char)' ';
         }
 
-        // mini-ascii offsets by first 32 unused glyphs
-        return (unsigned char)text[index] - 32;
+        // mini-ascii offsets by first 32 unused glyphs; control characters
+        // (e.g. tabs) have no glyph, so draw them as spaces
+        unsigned char c = text[index];
+        return c < 32 ? 0 : c - 32;
+    }
+
+    static size_t hashLayout(std::string_view text, SDL_Rect bound)
+    {
+        size_t h = std::hash<std::string_view>()(text);
+        h ^= ((size_t)bound.x * 73856093) ^ ((size_t)bound.y * 19349663) ^ ((size_t)bound.w * 83492791) ^ ((size_t)bound.h * 2654435761u);
+        return h;
+    }
+
+    // Word-wraps text within bound into glyph source/destination rects
+    void layout(std::string_view text, const SDL_Rect &bound, Layout &out)
+    {
+        mCurrX = bound.x;
+        mCurrY = bound.y;
+
+        int length = text.length();
+        for (int c = 0; c < length; c++)
+        {
+            // pre-trim whitespaces from first word in the line
+            int fullAscii = getFullAscii(text, c);
+            while (mCurrX == bound.x && fullAscii == ' ' && c < length)
+            {
+                c++;
+                fullAscii = getFullAscii(text, c);
+            }
+
+            // nothing but whitespace left
+            if (c >= length)
+            {
+                break;
+            }
+
+            // if we encounter a linebreak, break and start over
+            if (fullAscii == '\n')
+            {
+                mCurrX = bound.x;
+                mCurrY += (mPaddingV + mFontSize);
+                continue;
+            }
+
+            // get end index of word
+            int endPos = c + 1;
+            int endPosFullAscii = getFullAscii(text, endPos);
+            while (endPosFullAscii != ' ' && endPosFullAscii != '\n')
+            {
+                endPos++;
+                endPosFullAscii = getFullAscii(text, endPos);
+            }
+            int currFullWidth = mCurrX + ((endPos - c) * mFontSize);
+
+            // if word is not first in line and exceeds bound width, break to new line
+            if (mCurrX != bound.x && currFullWidth > bound.x + bound.w)
+            {
+                mCurrX = bound.x;
+                mCurrY += (mPaddingV + mFontSize);
+                continue;
+            }
+
+            for (; c < endPos; c++)
+            {
+                int miniAscii = getMiniAscii(text, c);
+                out.src.push_back(mChars[(unsigned char)miniAscii]);
+                out.dst.push_back({mCurrX, mCurrY, mFontSize, mFontSize});
+                out.chars.push_back(c);
+
+                mCurrX += mFontSize;
+            }
+
+            c--;
+        }
+
+#ifdef WY_FONT_GEOMETRY
+        for (size_t i = 0; i < out.src.size(); i++)
+        {
+            SDL_Rect &s = out.src[i];
+            SDL_Rect &d = out.dst[i];
+
+            float u0 = (float)s.x / mTexW, v0 = (float)s.y / mTexH;
+            float u1 = (float)(s.x + s.w) / mTexW, v1 = (float)(s.y + s.h) / mTexH;
+            float x0 = d.x, y0 = d.y, x1 = d.x + d.w, y1 = d.y + d.h;
+
+            out.vertices.push_back({{x0, y0}, {0xFF, 0xFF, 0xFF, 0xFF}, {u0, v0}});
+            out.vertices.push_back({{x1, y0}, {0xFF, 0xFF, 0xFF, 0xFF}, {u1, v0}});
+            out.vertices.push_back({{x1, y1}, {0xFF, 0xFF, 0xFF, 0xFF}, {u1, v1}});
+            out.vertices.push_back({{x0, y1}, {0xFF, 0xFF, 0xFF, 0xFF}, {u0, v1}});
+        }
+
+        for (int i = mIndices.size() / 6; i < (int)out.src.size(); i++)
+        {
+            int v = i * 4;
+            mIndices.insert(mIndices.end(), {v, v + 1, v + 2, v, v + 2, v + 3});
+        }
+#endif
+    }
+
+    // Returns the cached layout of text in bound, laying it out on a miss
+    Layout &getLayout(std::string_view text, const SDL_Rect &bound)
+    {
+        mPrintCount++;
+
+        size_t key = hashLayout(text, bound);
+        Layout *oldest = nullptr;
+        for (auto &cached : mLayouts)
+        {
+            if (cached.key == key && cached.text == text && SDL_RectEquals(&cached.bound, &bound))
+            {
+                cached.nLastUsed = mPrintCount;
+                return cached;
+            }
+
+            if (oldest == nullptr || cached.nLastUsed < oldest->nLastUsed)
+            {
+                oldest = &cached;
+            }
+        }
+
+        // Reuse the least recently printed slot once the cache is full; its
+        // buffers keep their capacity, so changing text stops allocating
+        if (mLayouts.size() < mLayoutCapacity)
+        {
+            mLayouts.emplace_back();
+            oldest = &mLayouts.back();
+        }
+
+        Layout &newLayout = *oldest;
+        newLayout.key = key;
+        newLayout.text.assign(text.data(), text.length());
+        newLayout.bound = bound;
+        newLayout.nLastUsed = mPrintCount;
+        newLayout.src.clear();
+        newLayout.dst.clear();
+        newLayout.chars.clear();
+#ifdef WY_FONT_GEOMETRY
+        newLayout.vertices.clear();
+#endif
+        layout(text, bound, newLayout);
+        return newLayout;
+    }
+
+    void drawLayout(SDL_Renderer *renderer, Layout &cached)
+    {
+        if (cached.src.empty())
+        {
+            return;
+        }
+
+#ifdef WY_FONT_GEOMETRY
+        SDL_RenderGeometry(renderer, mTexture, cached.vertices.data(), cached.vertices.size(), mIndices.data(), cached.src.size() * 6);
+#else
+        for (size_t i = 0; i < cached.src.size(); i++)
+        {
+            SDL_RenderCopy(renderer, mTexture, &cached.src[i], &cached.dst[i]);
+        }
+#endif
     }
 
 public:
@@ -68,21 +271,39 @@ public:
         mDebug = flag;
     }
 
-    WY_MonoFont(SDL_Texture *t, int fs, int vp, SDL_Rect b)
+    // Number of distinct texts (per bound) kept laid out; raise it for text-heavy screens
+    void setLayoutCapacity(size_t capacity)
+    {
+        mLayoutCapacity = capacity > 0 ? capacity : 1;
+        mLayouts.clear();
+        mLayouts.reserve(mLayoutCapacity);
+    }
+
+    // Uses only the sheet area of the texture, e.g. a font packed in a WY_Atlas
+    WY_MonoFont(SDL_Texture *t, SDL_Rect sheet, int fs, int vp, SDL_Rect b)
     {
         mTexture = t;
+        mSheet = sheet;
         mFontSize = fs;
         mPaddingV = vp;
         mBound = b;
         mDebug = false;
+        mLayouts.reserve(mLayoutCapacity);
 
         buildFonts();
     }
 
+    WY_MonoFont(SDL_Texture *t, int fs, int vp, SDL_Rect b) : WY_MonoFont(t, {0, 0, 0, 0}, fs, vp, b) {}
     WY_MonoFont(SDL_Texture *t, int fs, int vp) : WY_MonoFont(t, fs, vp, {0, 0, 0, 0}) {}
     WY_MonoFont(SDL_Texture *t, int fs) : WY_MonoFont(t, fs, 4, {0, 0, 0, 0}) {}
     WY_MonoFont(SDL_Texture *t) : WY_MonoFont(t, 8, 4, {0, 0, 0, 0}) {}
 
+    // Font for WY_Framebuffer drawing; print(renderer, ...) doesn't work with it
+    WY_MonoFont(const WY_Bitmap *bitmap, int fs, int vp, SDL_Rect b) : WY_MonoFont(nullptr, {0, 0, bitmap->w, bitmap->h}, fs, vp, b)
+    {
+        mBitmap = bitmap;
+    }
+
     ~WY_MonoFont()
     {
         mTexture = nullptr;
@@ -107,7 +328,17 @@ public:
         print(renderer, str);
     }
 
-    void print(SDL_Renderer *renderer, std::string text)
+    void print(SDL_Renderer *renderer, const std::string &text)
+    {
+        print(renderer, std::string_view(text));
+    }
+
+    void print(SDL_Renderer *renderer, const char *text)
+    {
+        print(renderer, std::string_view(text));
+    }
+
+    void print(SDL_Renderer *renderer, std::string_view text)
     {
         if (mTexture == nullptr)
         {
@@ -121,61 +352,310 @@ public:
             SDL_RenderDrawRect(renderer, &mBound);
         }
 
-        mCurrX = mBound.x;
-        mCurrY = mBound.y;
+        drawLayout(renderer, getLayout(text, mBound));
+
+        // IMPROVEMENTS
+        // - colorize font
+        // - animate to appear letter by letter
+        // - animate each character with wobbly effect
+        // - add custom animation per character
+    }
 
-        for (int c = 0; c < text.length(); c++)
+    // Draws into a software framebuffer, using the same cached layout as print(renderer, ...)
+    void print(WY_Framebuffer *framebuffer, std::string_view text)
+    {
+        if (mBitmap == nullptr)
         {
-            // pre-trim whitespaces from first word in the line
-            int fullAscii = getFullAscii(text, c);
-            while (mCurrX == mBound.x && fullAscii == ' ')
+            SDL_Log("Font bitmap missing!\n");
+            return;
+        }
+
+        if (mDebug)
+        {
+            framebuffer->fillRect({mBound.x, mBound.y, mBound.w, 1}, 0x00FF00FF);
+            framebuffer->fillRect({mBound.x, mBound.y + mBound.h - 1, mBound.w, 1}, 0x00FF00FF);
+            framebuffer->fillRect({mBound.x, mBound.y, 1, mBound.h}, 0x00FF00FF);
+            framebuffer->fillRect({mBound.x + mBound.w - 1, mBound.y, 1, mBound.h}, 0x00FF00FF);
+        }
+
+        Layout &cached = getLayout(text, mBound);
+        for (size_t i = 0; i < cached.src.size(); i++)
+        {
+            framebuffer->blit(*mBitmap, cached.src[i], cached.dst[i].x, cached.dst[i].y, BLIT_COLORKEY);
+        }
+    }
+};
+
+struct WY_TextStats
+{
+    int nGlyphs = 0;        // glyphs shown by the last draw
+    int nGlyphsDrawn = 0;   // glyphs re-rasterized by the last draw
+    int nGlyphsSaved = 0;   // glyphs the last draw didn't have to draw, i.e. nGlyphs - nGlyphsDrawn
+    int nFullRenders = 0;   // total re-renders of the whole block
+    int nSpanRenders = 0;   // total partial re-renders of changed characters
+    long nTotalSaved = 0;   // total glyph draws saved since creation
+};
+
+// A block of mostly static text, rasterized once into its own texture.
+//
+// draw() is a single SDL_RenderCopy while the text stays the same. When only
+// some characters change and no spaces or line breaks move (e.g. a counter
+// going from 120 to 125), only those characters are redrawn into the texture.
+// Anything else re-renders the whole block.
+class WY_TextBlock
+{
+    WY_MonoFont *mFont;
+    SDL_Rect mBound;
+    std::string mText;
+
+    SDL_Texture *mTexture = nullptr;
+    int mTexW = 0, mTexH = 0;
+
+    bool bDirty = true;
+    int nSpanFirst = -1, nSpanLast = -1; // changed characters, when only a span is dirty
+    WY_TextStats mStats;
+
+    // Layout in texture space, i.e. at 0,0 instead of at the bound's position
+    WY_MonoFont::Layout &getLayout()
+    {
+        return mFont->getLayout(mText, {0, 0, mBound.w, mBound.h});
+    }
+
+    static bool isBreak(char c)
+    {
+        return c == ' ' || c == '\n';
+    }
+
+    bool createTexture(SDL_Renderer *renderer, int w, int h)
+    {
+        if (mTexture != nullptr && w <= mTexW && h <= mTexH)
+        {
+            return true;
+        }
+
+        if (mTexture != nullptr)
+        {
+            SDL_DestroyTexture(mTexture);
+        }
+
+        mTexW = std::max(w, mTexW);
+        mTexH = std::max(h, mTexH);
+        mTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, mTexW, mTexH);
+        if (mTexture == nullptr)
+        {
+            SDL_Log("Unable to create text block texture! SDL Error: %s\n", SDL_GetError());
+            mTexW = mTexH = 0;
+            return false;
+        }
+
+        SDL_SetTextureBlendMode(mTexture, SDL_BLENDMODE_BLEND);
+        return true;
+    }
+
+    void renderFull(SDL_Renderer *renderer, WY_MonoFont::Layout &layout)
+    {
+        int w = 1, h = 1;
+        for (auto &dst : layout.dst)
+        {
+            w = std::max(w, dst.x + dst.w);
+            h = std::max(h, dst.y + dst.h);
+        }
+
+        if (!createTexture(renderer, w, h))
+        {
+            return;
+        }
+
+        SDL_SetRenderTarget(renderer, mTexture);
+        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0x00);
+        SDL_RenderClear(renderer);
+        mFont->drawLayout(renderer, layout);
+
+        mStats.nGlyphsDrawn = layout.src.size();
+        mStats.nFullRenders++;
+    }
+
+    void renderSpan(SDL_Renderer *renderer, WY_MonoFont::Layout &layout)
+    {
+        SDL_BlendMode blendMode;
+        SDL_GetRenderDrawBlendMode(renderer, &blendMode);
+
+        // Punch the old glyphs out to transparent before drawing the new ones
+        SDL_SetRenderTarget(renderer, mTexture);
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0x00);
+
+        int nDrawn = 0;
+        for (size_t i = 0; i < layout.chars.size(); i++)
+        {
+            if (layout.chars[i] < nSpanFirst || layout.chars[i] > nSpanLast)
             {
-                c++;
-                fullAscii = getFullAscii(text, c);
+                continue;
             }
 
-            // if we encounter a linebreak, break and start over
-            if (fullAscii == '\n')
+            SDL_RenderFillRect(renderer, &layout.dst[i]);
+            SDL_RenderCopy(renderer, mFont->mTexture, &layout.src[i], &layout.dst[i]);
+            nDrawn++;
+        }
+
+        SDL_SetRenderDrawBlendMode(renderer, blendMode);
+
+        mStats.nGlyphsDrawn = nDrawn;
+        mStats.nSpanRenders++;
+    }
+
+public:
+    WY_TextBlock(WY_MonoFont *font, SDL_Rect bound)
+    {
+        mFont = font;
+        mBound = bound;
+    }
+
+    ~WY_TextBlock()
+    {
+        if (mTexture != nullptr)
+        {
+            SDL_DestroyTexture(mTexture);
+        }
+    }
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    const std::string &getText()
+    {
+        return mText;
+    }
+
+    SDL_Rect getBound()
+    {
+        return mBound;
+    }
+
+    const WY_TextStats &getStats()
+    {
+        return mStats;
+    }
+
+    // ==================================================
+    // Setters
+    // ==================================================
+
+    // Cheap when the text is unchanged, so it can be called every frame
+    void setText(std::string_view text)
+    {
+        if (text == mText)
+        {
+            return;
+        }
+
+        // Same length and same breaks means the same word wrap, so only the
+        // changed characters need redrawing
+        bool bSpan = !bDirty && text.length() == mText.length();
+        int first = -1, last = -1;
+        for (size_t i = 0; bSpan && i < text.length(); i++)
+        {
+            if (text[i] == mText[i])
             {
-                mCurrX = mBound.x;
-                mCurrY += (mPaddingV + mFontSize);
                 continue;
             }
-
-            // get end index of word
-            int endPos = c + 1;
-            int endPosFullAscii = getFullAscii(text, endPos);
-            while (endPosFullAscii != ' ' && endPosFullAscii != '\n')
+            if (isBreak(text[i]) || isBreak(mText[i]))
             {
-                endPos++;
-                endPosFullAscii = getFullAscii(text, endPos);
+                bSpan = false;
+                break;
             }
-            int currFullWidth = mCurrX + ((endPos - c) * mFontSize);
-
-            // if word is not first in line and exceeds bound width, break to new line
-            if (mCurrX != mBound.x && currFullWidth > mBound.x + mBound.w)
+            if (first < 0)
             {
-                mCurrX = mBound.x;
-                mCurrY += (mPaddingV + mFontSize);
-                continue;
+                first = i;
             }
+            last = i;
+        }
 
-            for (; c < endPos; c++)
-            {
-                int miniAscii = getMiniAscii(text, c);
-                mDest = {mCurrX, mCurrY, mFontSize, mFontSize};
-                SDL_RenderCopy(renderer, mTexture, &mChars[miniAscii], &mDest);
+        if (bSpan)
+        {
+            // Merge with a span not drawn yet
+            nSpanFirst = nSpanFirst < 0 ? first : std::min(nSpanFirst, first);
+            nSpanLast = std::max(nSpanLast, last);
+        }
+        else
+        {
+            bDirty = true;
+        }
 
-                mCurrX += mFontSize;
+        mText.assign(text.data(), text.length());
+    }
+
+    void setBound(SDL_Rect bound)
+    {
+        // Moving only changes where the texture is drawn
+        if (bound.w != mBound.w || bound.h != mBound.h)
+        {
+            bDirty = true;
+        }
+        mBound = bound;
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    // Forces a full re-render, e.g. after SDL_RENDER_TARGETS_RESET
+    void invalidate()
+    {
+        bDirty = true;
+    }
+
+    void draw(SDL_Renderer *renderer)
+    {
+        WY_MonoFont::Layout &layout = getLayout();
+        mStats.nGlyphsDrawn = 0;
+
+        if (mTexture == nullptr)
+        {
+            bDirty = true;
+        }
+
+        if (bDirty || nSpanFirst >= 0)
+        {
+            // Render into our texture, then go back to whatever target, draw
+            // color, viewport and clip were set (e.g. Wyngine's dirty-rect
+            // clip). Changing the target resets the viewport and clip.
+            SDL_Texture *target = SDL_GetRenderTarget(renderer);
+            Uint8 r, g, b, a;
+            SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+            SDL_Rect viewport, clip;
+            SDL_RenderGetViewport(renderer, &viewport);
+            SDL_RenderGetClipRect(renderer, &clip);
+            bool bClipped = SDL_RenderIsClipEnabled(renderer);
+
+            if (bDirty)
+            {
+                renderFull(renderer, layout);
+            }
+            else
+            {
+                renderSpan(renderer, layout);
             }
 
-            c--;
+            SDL_SetRenderTarget(renderer, target);
+            SDL_RenderSetViewport(renderer, &viewport);
+            SDL_RenderSetClipRect(renderer, bClipped ? &clip : NULL);
+            SDL_SetRenderDrawColor(renderer, r, g, b, a);
+
+            bDirty = false;
+            nSpanFirst = nSpanLast = -1;
         }
 
-        // IMPROVEMENTS
-        // - colorize font
-        // - animate to appear letter by letter
-        // - animate each character with wobbly effect
-        // - add custom animation per character
+        mStats.nGlyphs = layout.src.size();
+        mStats.nGlyphsSaved = mStats.nGlyphs - mStats.nGlyphsDrawn;
+        mStats.nTotalSaved += mStats.nGlyphsSaved;
+
+        if (mTexture != nullptr)
+        {
+            SDL_Rect src = {0, 0, mTexW, mTexH};
+            SDL_Rect dst = {mBound.x, mBound.y, mTexW, mTexH};
+            SDL_RenderCopy(renderer, mTexture, &src, &dst);
+        }
     }
 };
@@ -0,0 +1,256 @@
+// Fixed-capacity string for per-frame text such as HUDs
+//
+// Lives on the stack (or inside an object) and never allocates, so building
+// "FPS : 60" every frame costs no heap traffic. Anything past the capacity is
+// dropped and isTruncated() is set. Converts to std::string_view, so
+// WY_MonoFont::print and WY_TextBlock::setText take it directly:
+//
+//   WY_StackString<64> hud;
+//   hud << "Bunnies : " << nCount << "\nFPS : " << timer->getFPS();
+//   mFont->print(mRenderer, hud);
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+template <size_t N = 256>
+class WY_StackString
+{
+    char mData[N];
+    size_t mLength = 0;
+    bool bTruncated = false;
+
+    void appendUnsigned(unsigned long long value, int width, char pad)
+    {
+        char digits[20];
+        int count = 0;
+        do
+        {
+            digits[count++] = '0' + value % 10;
+            value /= 10;
+        } while (value > 0);
+
+        for (int i = count; i < width; i++)
+        {
+            append(pad);
+        }
+        while (count > 0)
+        {
+            append(digits[--count]);
+        }
+    }
+
+public:
+    static_assert(N > 0, "WY_StackString needs room for the terminating zero");
+
+    WY_StackString()
+    {
+        mData[0] = '\0';
+    }
+
+    WY_StackString(std::string_view text) : WY_StackString()
+    {
+        append(text);
+    }
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    const char *c_str() const
+    {
+        return mData;
+    }
+
+    std::string_view view() const
+    {
+        return std::string_view(mData, mLength);
+    }
+
+    operator std::string_view() const
+    {
+        return view();
+    }
+
+    size_t length() const
+    {
+        return mLength;
+    }
+
+    size_t capacity() const
+    {
+        return N - 1;
+    }
+
+    bool empty() const
+    {
+        return mLength == 0;
+    }
+
+    // True if something was cut off since the last clear()
+    bool isTruncated() const
+    {
+        return bTruncated;
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    WY_StackString &clear()
+    {
+        mLength = 0;
+        mData[0] = '\0';
+        bTruncated = false;
+        return *this;
+    }
+
+    WY_StackString &append(char c)
+    {
+        if (mLength + 1 >= N)
+        {
+            bTruncated = true;
+            return *this;
+        }
+
+        mData[mLength++] = c;
+        mData[mLength] = '\0';
+        return *this;
+    }
+
+    WY_StackString &append(std::string_view text)
+    {
+        size_t count = text.length();
+        if (mLength + count >= N)
+        {
+            count = N - 1 - mLength;
+            bTruncated = true;
+        }
+
+        memcpy(mData + mLength, text.data(), count);
+        mLength += count;
+        mData[mLength] = '\0';
+        return *this;
+    }
+
+    // Integer, optionally padded on the left to width characters, e.g. (7, 3, '0') -> "007"
+    WY_StackString &appendInt(long long value, int width = 0, char pad = ' ')
+    {
+        if (value < 0)
+        {
+            append('-');
+            width--;
+            // negate in unsigned so LLONG_MIN works
+            appendUnsigned(0ULL - (unsigned long long)value, width, pad);
+        }
+        else
+        {
+            appendUnsigned(value, width, pad);
+        }
+        return *this;
+    }
+
+    // Fixed-point number with the given number of decimals, e.g. (12345, 2) -> "123.45"
+    WY_StackString &appendFixed(long long value, int decimals)
+    {
+        unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : value;
+        unsigned long long scale = 1;
+        for (int i = 0; i < decimals; i++)
+        {
+            scale *= 10;
+        }
+
+        if (value < 0)
+        {
+            append('-');
+        }
+
+        appendUnsigned(magnitude / scale, 0, '0');
+        if (decimals > 0)
+        {
+            append('.');
+            appendUnsigned(magnitude % scale, decimals, '0');
+        }
+        return *this;
+    }
+
+    // Float rounded to precision decimals (0 to 9), e.g. (3.14159, 2) -> "3.14"
+    WY_StackString &appendFloat(double value, int precision = 2)
+    {
+        precision = precision < 0 ? 0 : (precision > 9 ? 9 : precision);
+
+        if (std::isnan(value))
+        {
+            return append("nan");
+        }
+        if (std::isinf(value))
+        {
+            return append(value < 0 ? "-inf" : "inf");
+        }
+
+        double scale = 1.0;
+        for (int i = 0; i < precision; i++)
+        {
+            scale *= 10.0;
+        }
+
+        double scaled = std::round(std::fabs(value) * scale);
+        if (scaled < 9.0e18)
+        {
+            long long fixed = (long long)scaled;
+            if (value < 0 && fixed != 0)
+            {
+                fixed = -fixed;
+            }
+            return appendFixed(fixed, precision);
+        }
+
+        // Too large for the integer path; printf doesn't allocate for this
+        char buffer[352];
+        snprintf(buffer, sizeof(buffer), "%.*f", precision, value);
+        return append(buffer);
+    }
+
+    // ==================================================
+    // Stream-style appending
+    // ==================================================
+
+    WY_StackString &operator<<(std::string_view text)
+    {
+        return append(text);
+    }
+
+    WY_StackString &operator<<(const char *text)
+    {
+        return append(std::string_view(text));
+    }
+
+    WY_StackString &operator<<(char c)
+    {
+        return append(c);
+    }
+
+    // Integers (and bool, as 0/1 like std::to_string)
+    template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    WY_StackString &operator<<(T value)
+    {
+        if (std::is_signed<T>::value)
+        {
+            return appendInt((long long)value);
+        }
+
+        appendUnsigned((unsigned long long)value, 0, ' ');
+        return *this;
+    }
+
+    // Six decimals, like std::to_string
+    WY_StackString &operator<<(double value)
+    {
+        return appendFloat(value, 6);
+    }
+};
@@ -0,0 +1,372 @@
+// Software rendering
+//
+// A CPU-side RGBA8888 framebuffer with blitters, for retro-resolution games
+// where pushing every sprite through SDL_Renderer costs more than the pixels
+// themselves. Wyngine uploads it to the screen once per frame with a single
+// streaming texture update (see WY_BACKEND_SOFTWARE in wyngine.h).
+//
+// Pixels are Uint32 0xRRGGBBAA, i.e. the same RGBA8888 layout as textures
+// from loadPNG, so color-keyed pixels are simply the ones with alpha 0.
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "image.h"
+
+enum WY_BlitMode
+{
+    BLIT_OPAQUE,   // copy as-is
+    BLIT_COLORKEY, // skip pixels with alpha 0 (color-keyed PNGs)
+    BLIT_ALPHA     // blend by source alpha
+};
+
+// Image in CPU memory that can be blitted into a WY_Framebuffer
+struct WY_Bitmap
+{
+    std::vector<Uint32> pixels;
+    int w = 0, h = 0; // pitch is w
+
+    Uint32 *row(int y)
+    {
+        return pixels.data() + y * w;
+    }
+
+    const Uint32 *row(int y) const
+    {
+        return pixels.data() + y * w;
+    }
+};
+
+// Decodes a PNG into a bitmap with the usual color key applied. Empty (w = 0) on failure.
+WY_Bitmap *loadBitmap(const std::string &path)
+{
+    WY_Bitmap *bitmap = new WY_Bitmap();
+
+    SDL_Surface *surface = decodePNG(path, false);
+    if (surface == NULL)
+    {
+        return bitmap;
+    }
+
+    bitmap->w = surface->w;
+    bitmap->h = surface->h;
+    bitmap->pixels.resize(surface->w * surface->h);
+
+    Uint32 colorKey = SDL_MapRGB(surface->format, 0xFF, 0xFF, 0xFF);
+    Uint32 transparent = SDL_MapRGBA(surface->format, 0x00, 0xFF, 0xFF, 0x00);
+    copyColorKey(bitmap->pixels.data(), bitmap->w * 4, surface->pixels, surface->pitch, surface->w, surface->h, colorKey, transparent);
+
+    SDL_FreeSurface(surface);
+    return bitmap;
+}
+
+// ==================================================
+// Row kernels
+// ==================================================
+
+typedef void (*WY_BlitRow)(Uint32 *dst, const Uint32 *src, int count);
+
+void blitRowOpaque(Uint32 *dst, const Uint32 *src, int count)
+{
+    memcpy(dst, src, count * 4);
+}
+
+void blitRowColorKeyScalar(Uint32 *dst, const Uint32 *src, int count)
+{
+    for (int x = 0; x < count; x++)
+    {
+        if ((src[x] & 0xFF) != 0)
+        {
+            dst[x] = src[x];
+        }
+    }
+}
+
+// (s * a + d * (255 - a)) / 255 per channel, alpha included
+inline Uint32 blendPixel(Uint32 s, Uint32 d)
+{
+    Uint32 a = s & 0xFF;
+    Uint32 out = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        Uint32 t = ((s >> shift) & 0xFF) * a + ((d >> shift) & 0xFF) * (255 - a) + 128;
+        out |= (((t + (t >> 8)) >> 8) & 0xFF) << shift;
+    }
+    return out;
+}
+
+void blitRowAlphaScalar(Uint32 *dst, const Uint32 *src, int count)
+{
+    for (int x = 0; x < count; x++)
+    {
+        Uint32 a = src[x] & 0xFF;
+        if (a == 0xFF)
+        {
+            dst[x] = src[x];
+        }
+        else if (a != 0)
+        {
+            dst[x] = blendPixel(src[x], dst[x]);
+        }
+    }
+}
+
+#ifdef WY_IMAGE_X86
+WY_TARGET("sse2")
+void blitRowColorKeySSE2(Uint32 *dst, const Uint32 *src, int count)
+{
+    __m128i alphaMask = _mm_set1_epi32(0xFF);
+    __m128i zero = _mm_setzero_si128();
+
+    int x = 0;
+    for (; x + 4 <= count; x += 4)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + x));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+        __m128i keep = _mm_cmpeq_epi32(_mm_and_si128(s, alphaMask), zero); // transparent: keep dst
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_or_si128(_mm_and_si128(keep, d), _mm_andnot_si128(keep, s)));
+    }
+
+    blitRowColorKeyScalar(dst + x, src + x, count - x);
+}
+
+// Blends two pixels held as 16-bit channels
+WY_TARGET("sse2")
+inline __m128i blendSSE2(__m128i s, __m128i d)
+{
+    // Alpha is the low channel of each pixel; spread it over all four
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0x00), 0x00);
+    __m128i ia = _mm_sub_epi16(_mm_set1_epi16(255), a);
+
+    __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, ia)), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+WY_TARGET("sse2")
+void blitRowAlphaSSE2(Uint32 *dst, const Uint32 *src, int count)
+{
+    __m128i zero = _mm_setzero_si128();
+
+    int x = 0;
+    for (; x + 4 <= count; x += 4)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + x));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+
+        __m128i lo = blendSSE2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+        __m128i hi = blendSSE2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(lo, hi));
+    }
+
+    blitRowAlphaScalar(dst + x, src + x, count - x);
+}
+#endif
+
+WY_BlitRow getBlitRow(WY_BlitMode mode)
+{
+    if (mode == BLIT_OPAQUE)
+    {
+        return blitRowOpaque;
+    }
+
+#ifdef WY_IMAGE_X86
+    static const bool bSSE2 = SDL_HasSSE2();
+    if (bSSE2)
+    {
+        return mode == BLIT_COLORKEY ? blitRowColorKeySSE2 : blitRowAlphaSSE2;
+    }
+#endif
+
+    return mode == BLIT_COLORKEY ? blitRowColorKeyScalar : blitRowAlphaScalar;
+}
+
+// ==================================================
+// Framebuffer
+// ==================================================
+
+class WY_Framebuffer
+{
+    std::vector<Uint32> mPixels;
+    std::vector<Uint32> mScaledRow; // scratch for blitScaled
+    int mW, mH;
+    SDL_Rect mClip;
+
+    // Clips a w x h blit at x, y; returns false if nothing is left.
+    // On success dst is the visible part and sx, sy how far into the source it starts.
+    bool clip(int x, int y, int w, int h, SDL_Rect &dst, int &sx, int &sy)
+    {
+        SDL_Rect rect = {x, y, w, h};
+        if (!SDL_IntersectRect(&rect, &mClip, &dst))
+        {
+            return false;
+        }
+
+        sx = dst.x - x;
+        sy = dst.y - y;
+        return true;
+    }
+
+    // Trims src to the bitmap, moving x, y by what was cut off its top-left
+    // (times scale); returns false if nothing is left
+    static bool clipSource(const WY_Bitmap &bitmap, SDL_Rect &src, int &x, int &y, int scale)
+    {
+        SDL_Rect bounds = {0, 0, bitmap.w, bitmap.h};
+        SDL_Rect trimmed;
+        if (!SDL_IntersectRect(&src, &bounds, &trimmed))
+        {
+            return false;
+        }
+
+        x += (trimmed.x - src.x) * scale;
+        y += (trimmed.y - src.y) * scale;
+        src = trimmed;
+        return true;
+    }
+
+public:
+    WY_Framebuffer(int w, int h)
+    {
+        mW = w;
+        mH = h;
+        mPixels.resize(w * h);
+        mClip = {0, 0, w, h};
+    }
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    int getW()
+    {
+        return mW;
+    }
+
+    int getH()
+    {
+        return mH;
+    }
+
+    // Bytes per row, for SDL_UpdateTexture
+    int getPitch()
+    {
+        return mW * 4;
+    }
+
+    Uint32 *getPixels()
+    {
+        return mPixels.data();
+    }
+
+    Uint32 *row(int y)
+    {
+        return mPixels.data() + y * mW;
+    }
+
+    SDL_Rect getClip()
+    {
+        return mClip;
+    }
+
+    // ==================================================
+    // Setters
+    // ==================================================
+
+    // Limits all drawing to rect; NULL resets to the whole framebuffer
+    void setClip(const SDL_Rect *rect)
+    {
+        SDL_Rect screen = {0, 0, mW, mH};
+        if (rect == NULL || !SDL_IntersectRect(rect, &screen, &mClip))
+        {
+            mClip = rect == NULL ? screen : SDL_Rect{0, 0, 0, 0};
+        }
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    // color is 0xRRGGBBAA
+    void fillRect(const SDL_Rect &rect, Uint32 color)
+    {
+        SDL_Rect dst;
+        int sx, sy;
+        if (!clip(rect.x, rect.y, rect.w, rect.h, dst, sx, sy))
+        {
+            return;
+        }
+
+        for (int y = dst.y; y < dst.y + dst.h; y++)
+        {
+            std::fill(row(y) + dst.x, row(y) + dst.x + dst.w, color);
+        }
+    }
+
+    void clear(Uint32 color)
+    {
+        fillRect(mClip, color);
+    }
+
+    // Draws the src rect of a bitmap with its top-left corner at x, y
+    void blit(const WY_Bitmap &bitmap, SDL_Rect src, int x, int y, WY_BlitMode mode = BLIT_COLORKEY)
+    {
+        SDL_Rect dst;
+        int sx, sy;
+        if (!clipSource(bitmap, src, x, y, 1) || !clip(x, y, src.w, src.h, dst, sx, sy))
+        {
+            return;
+        }
+
+        WY_BlitRow blitRow = getBlitRow(mode);
+        for (int y = 0; y < dst.h; y++)
+        {
+            blitRow(row(dst.y + y) + dst.x, bitmap.row(src.y + sy + y) + src.x + sx, dst.w);
+        }
+    }
+
+    void blit(const WY_Bitmap &bitmap, int x, int y, WY_BlitMode mode = BLIT_COLORKEY)
+    {
+        blit(bitmap, {0, 0, bitmap.w, bitmap.h}, x, y, mode);
+    }
+
+    // Draws the src rect of a bitmap scaled up by a whole number (nearest neighbour)
+    void blitScaled(const WY_Bitmap &bitmap, SDL_Rect src, int x, int y, int scale, WY_BlitMode mode = BLIT_COLORKEY)
+    {
+        if (scale <= 1)
+        {
+            blit(bitmap, src, x, y, mode);
+            return;
+        }
+
+        SDL_Rect dst;
+        int sx, sy;
+        if (!clipSource(bitmap, src, x, y, scale) || !clip(x, y, src.w * scale, src.h * scale, dst, sx, sy))
+        {
+            return;
+        }
+
+        WY_BlitRow blitRow = getBlitRow(mode);
+        mScaledRow.resize(dst.w);
+
+        int lastSrcY = -1;
+        for (int y = 0; y < dst.h; y++)
+        {
+            // Each source row is widened once and reused for its scale copies
+            int srcY = src.y + (sy + y) / scale;
+            if (srcY != lastSrcY)
+            {
+                const Uint32 *srcRow = bitmap.row(srcY) + src.x;
+                for (int x = 0; x < dst.w; x++)
+                {
+                    mScaledRow[x] = srcRow[(sx + x) / scale];
+                }
+                lastSrcY = srcY;
+            }
+
+            blitRow(row(dst.y + y) + dst.x, mScaledRow.data(), dst.w);
+        }
+    }
+};
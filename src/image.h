@@ -1,6 +1,8 @@
 // http://lazyfoo.net/tutorials/SDL/06_extension_libraries_and_loading_other_image_formats/index2.php
 // https://lazyfoo.net/tutorials/SDL/43_render_to_texture/index.php
 
+#pragma once
+
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <cstring>
@@ -21,72 +23,201 @@ struct WY_Sprite
 
 struct WY_Image
 {
-    SDL_Texture *texture;
-    int w, h;
+    SDL_Texture *texture = NULL;
+    int w = 0, h = 0;
 };
 
-WY_Image *loadPNG(SDL_Renderer *renderer, std::string path)
+// ==================================================
+// Color key copy
+// ==================================================
+//
+// Copies one row of 32-bit pixels, replacing every pixel equal to colorKey
+// with transparent on the way. This is the only pass over the pixels at load
+// time, so it is vectorized: AVX2 or SSE2 when the CPU has them, picked once
+// at runtime so the default (non -march) builds still get them.
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define WY_IMAGE_X86
+#include <immintrin.h>
+#endif
+
+#if defined(WY_IMAGE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define WY_TARGET(isa) __attribute__((target(isa)))
+#else
+#define WY_TARGET(isa)
+#endif
+
+typedef void (*WY_ColorKeyRow)(Uint32 *dst, const Uint32 *src, int count, Uint32 colorKey, Uint32 transparent);
+
+void colorKeyRowScalar(Uint32 *dst, const Uint32 *src, int count, Uint32 colorKey, Uint32 transparent)
 {
-    SDL_Surface *loadedSurface = IMG_Load(path.c_str());
-    SDL_Texture *newTexture = NULL;
-    WY_Image *newImage = new WY_Image();
+    for (int x = 0; x < count; ++x)
+    {
+        dst[x] = src[x] == colorKey ? transparent : src[x];
+    }
+}
+
+#ifdef WY_IMAGE_X86
+WY_TARGET("sse2")
+void colorKeyRowSSE2(Uint32 *dst, const Uint32 *src, int count, Uint32 colorKey, Uint32 transparent)
+{
+    __m128i key = _mm_set1_epi32((int)colorKey);
+    __m128i replace = _mm_set1_epi32((int)transparent);
+
+    int x = 0;
+    for (; x + 4 <= count; x += 4)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i *)(src + x));
+        __m128i mask = _mm_cmpeq_epi32(pixels, key);
+        pixels = _mm_or_si128(_mm_and_si128(mask, replace), _mm_andnot_si128(mask, pixels));
+        _mm_storeu_si128((__m128i *)(dst + x), pixels);
+    }
+
+    colorKeyRowScalar(dst + x, src + x, count - x, colorKey, transparent);
+}
+
+WY_TARGET("avx2")
+void colorKeyRowAVX2(Uint32 *dst, const Uint32 *src, int count, Uint32 colorKey, Uint32 transparent)
+{
+    __m256i key = _mm256_set1_epi32((int)colorKey);
+    __m256i replace = _mm256_set1_epi32((int)transparent);
+
+    int x = 0;
+    for (; x + 8 <= count; x += 8)
+    {
+        __m256i pixels = _mm256_loadu_si256((const __m256i *)(src + x));
+        __m256i mask = _mm256_cmpeq_epi32(pixels, key);
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_blendv_epi8(pixels, replace, mask));
+    }
+
+    colorKeyRowScalar(dst + x, src + x, count - x, colorKey, transparent);
+}
+#endif
+
+WY_ColorKeyRow getColorKeyRow()
+{
+#ifdef WY_IMAGE_X86
+    if (SDL_HasAVX2())
+    {
+        return colorKeyRowAVX2;
+    }
+    if (SDL_HasSSE2())
+    {
+        return colorKeyRowSSE2;
+    }
+#endif
+    return colorKeyRowScalar;
+}
+
+// Copies a w x h block of 32-bit pixels between buffers with their own pitch,
+// applying the color key. dst and src may be the same buffer.
+void copyColorKey(void *dst, int dstPitch, const void *src, int srcPitch, int w, int h, Uint32 colorKey, Uint32 transparent)
+{
+    static const WY_ColorKeyRow colorKeyRow = getColorKeyRow();
+
+    for (int y = 0; y < h; ++y)
+    {
+        colorKeyRow((Uint32 *)((Uint8 *)dst + y * dstPitch), (const Uint32 *)((const Uint8 *)src + y * srcPitch), w, colorKey, transparent);
+    }
+}
 
+// ==================================================
+// Loading
+// ==================================================
+
+// 32-bit formats with alpha that every renderer takes as a texture format
+bool isTextureFormat(Uint32 format)
+{
+    return format == SDL_PIXELFORMAT_RGBA8888 || format == SDL_PIXELFORMAT_ABGR8888 ||
+           format == SDL_PIXELFORMAT_ARGB8888 || format == SDL_PIXELFORMAT_BGRA8888;
+}
+
+// Decodes a PNG into a 32-bit surface. Only touches CPU memory, so it is safe
+// to call from a worker thread. The color key is applied later, by uploadImage.
+//
+// keepFormat skips the conversion when the PNG already decodes to a 32-bit
+// format with alpha (SDL_image gives RGBA PNGs as ABGR8888 on little-endian),
+// and the texture is then created in that format. Pass false to always get
+// RGBA8888, e.g. when pixels will be read back and poked at directly.
+SDL_Surface *decodePNG(const std::string &path, bool keepFormat = true)
+{
+    SDL_Surface *loadedSurface = IMG_Load(path.c_str());
     if (loadedSurface == NULL)
     {
         SDL_Log("Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError());
+        return NULL;
+    }
+
+    Uint32 format = loadedSurface->format->format;
+    if (format == SDL_PIXELFORMAT_RGBA8888 || (keepFormat && isTextureFormat(format)))
+    {
+        return loadedSurface;
+    }
+
+    SDL_Surface *formattedSurface = SDL_ConvertSurfaceFormat(loadedSurface, SDL_PIXELFORMAT_RGBA8888, 0);
+    if (formattedSurface == NULL)
+    {
+        SDL_Log("Unable to convert loaded surface to display format! %s\n", SDL_GetError());
+    }
+
+    SDL_FreeSurface(loadedSurface);
+
+    return formattedSurface;
+}
+
+// Uploads a surface from decodePNG into a new streaming texture of the same
+// format, color keying white pixels to transparent during the copy.
+// Must be called from the thread that owns the renderer.
+WY_Image *uploadImage(SDL_Renderer *renderer, SDL_Surface *surface, const std::string &path)
+{
+    WY_Image *newImage = new WY_Image();
+
+    if (surface == NULL)
+    {
+        return newImage;
+    }
+
+    SDL_Texture *newTexture = SDL_CreateTexture(renderer, surface->format->format, SDL_TEXTUREACCESS_STREAMING, surface->w, surface->h);
+    if (newTexture == NULL)
+    {
+        SDL_Log("Unable to create texture from %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+        return newImage;
     }
-    else
+
+    void *mPixels = NULL;
+    int mPitch = 0;
+
+    SDL_SetTextureBlendMode(newTexture, SDL_BLENDMODE_BLEND);
+
+    if (SDL_LockTexture(newTexture, NULL, &mPixels, &mPitch) < 0)
     {
-        SDL_Surface *formattedSurface = SDL_ConvertSurfaceFormat(loadedSurface, SDL_PIXELFORMAT_RGBA8888, 0);
-        if (formattedSurface == NULL)
-        {
-            SDL_Log("Unable to convert loaded surface to display format! %s\n", SDL_GetError());
-        }
-        else
-        {
-            SDL_SetColorKey(loadedSurface, SDL_TRUE, SDL_MapRGB(loadedSurface->format, 0, 0xFF, 0xFF));
-
-            newTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, formattedSurface->w, formattedSurface->h);
-            if (newTexture == NULL)
-            {
-                SDL_Log("Unable to create texture from %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
-            }
-            else
-            {
-                void *mPixels = NULL;
-                int mPitch = 0;
-                int w, h;
-
-                SDL_SetTextureBlendMode(newTexture, SDL_BLENDMODE_BLEND);
-
-                SDL_LockTexture(newTexture, &formattedSurface->clip_rect, &mPixels, &mPitch);
-
-                memcpy(mPixels, formattedSurface->pixels, formattedSurface->pitch * formattedSurface->h);
-                newImage->w = formattedSurface->w;
-                newImage->h = formattedSurface->h;
-
-                // Color key pixels
-                Uint32 *pixels = (Uint32 *)mPixels;
-                int pixelCount = (mPitch / 4) * newImage->h;
-                Uint32 colorKey = SDL_MapRGB(formattedSurface->format, 0xFF, 0xFF, 0xFF);
-                Uint32 transparent = SDL_MapRGBA(formattedSurface->format, 0x00, 0xFF, 0xFF, 0x00);
-                for (int i = 0; i < pixelCount; ++i)
-                {
-                    if (pixels[i] == colorKey)
-                    {
-                        pixels[i] = transparent;
-                    }
-                }
-
-                SDL_UnlockTexture(newTexture);
-            }
-
-            SDL_FreeSurface(formattedSurface);
-        }
-
-        SDL_FreeSurface(loadedSurface);
+        SDL_Log("Unable to lock texture from %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+        SDL_DestroyTexture(newTexture);
+        return newImage;
     }
 
+    // Color key pixels
+    Uint32 colorKey = SDL_MapRGB(surface->format, 0xFF, 0xFF, 0xFF);
+    Uint32 transparent = SDL_MapRGBA(surface->format, 0x00, 0xFF, 0xFF, 0x00);
+    copyColorKey(mPixels, mPitch, surface->pixels, surface->pitch, surface->w, surface->h, colorKey, transparent);
+
+    SDL_UnlockTexture(newTexture);
+
     newImage->texture = newTexture;
+    newImage->w = surface->w;
+    newImage->h = surface->h;
+    return newImage;
+}
+
+WY_Image *loadPNG(SDL_Renderer *renderer, std::string path)
+{
+    SDL_Surface *surface = decodePNG(path);
+    WY_Image *newImage = uploadImage(renderer, surface, path);
+
+    if (surface != NULL)
+    {
+        SDL_FreeSurface(surface);
+    }
+
     return newImage;
 }
@@ -1,38 +1,55 @@
 #include <SDL2/SDL.h>
 #include <string>
+#include <string_view>
 
-struct WY_Text
-{
-    std::string text;
-    std::string composition; // reserved for inputs like Asian characters
-    Sint32 cursor;
-    Sint32 selection_len;
-};
+#include "events.h"
+#include "text.h"
 
 class WY_IO
 {
-    WY_Text txt{"", "", 0, 0};
+    WY_TextBuffer txt;
 
 public:
     WY_IO() {}
 
-    std::string getText()
+    // The entered text, without copying it; valid until the next edit.
+    // Compare getVersion() between frames to see whether it changed.
+    std::string_view getText()
+    {
+        return txt.getText();
+    }
+
+    // Like getText(), but as two pieces, which never moves text around;
+    // prefer this for drawing the text every frame
+    WY_TextSpans getTextSpans(size_t start = 0, size_t end = SIZE_MAX)
     {
-        return txt.text.c_str();
+        return txt.getSpans(start, end);
+    }
+
+    Uint64 getVersion()
+    {
+        return txt.getVersion();
     }
 
     int getCursor()
     {
-        return txt.cursor;
+        return txt.getCursor();
     }
 
-    void update(SDL_Event *windowEvent, int hasEvent)
+    // Text being composed with an IME (e.g. for Asian characters), not entered yet
+    std::string_view getComposition()
     {
-        if (hasEvent == 0)
-        {
-            return;
-        }
+        return txt.getComposition();
+    }
 
+    // For cursor, selection and direct edits
+    WY_TextBuffer &getTextBuffer()
+    {
+        return txt;
+    }
+
+    void handleEvent(const SDL_Event *windowEvent)
+    {
         int keycode = windowEvent->key.keysym.sym;
         int type = windowEvent->type;
 
@@ -40,32 +57,75 @@ public:
         {
         case SDL_KEYDOWN:
         {
+            // While composing, the IME handles editing keys itself
+            if (txt.isComposing())
+            {
+                break;
+            }
+
+            bool bShift = windowEvent->key.keysym.mod & KMOD_SHIFT;
+
             switch (keycode)
             {
             case SDLK_BACKSPACE:
-                if (txt.text.length() > 0)
+                txt.deleteBackward();
+                break;
+
+            case SDLK_DELETE:
+                txt.deleteForward();
+                break;
+
+            case SDLK_LEFT:
+                txt.moveLeft(bShift);
+                break;
+
+            case SDLK_RIGHT:
+                txt.moveRight(bShift);
+                break;
+
+            case SDLK_HOME:
+                txt.moveHome(bShift);
+                break;
+
+            case SDLK_END:
+                txt.moveEnd(bShift);
+                break;
+
+            case SDLK_a:
+                if (windowEvent->key.keysym.mod & KMOD_CTRL)
                 {
-                    txt.text.pop_back();
+                    txt.selectAll();
                 }
                 break;
 
             case SDLK_RETURN:
             case SDLK_RETURN2:
-                txt.text.append("\n");
+                txt.insert("\n");
                 break;
             }
         }
         break;
 
         case SDL_TEXTINPUT:
-            txt.text.append(windowEvent->text.text);
+            if (txt.isComposing())
+            {
+                txt.setComposition("", 0, 0);
+            }
+            txt.insert(windowEvent->text.text);
             break;
 
         case SDL_TEXTEDITING:
-            txt.composition = windowEvent->edit.text;
-            txt.cursor = windowEvent->edit.start;
-            txt.selection_len = windowEvent->edit.length;
+            txt.setComposition(windowEvent->edit.text, windowEvent->edit.start, windowEvent->edit.length);
             break;
         }
     }
+
+    // Call once per frame, after the frame's events were polled
+    void update(const WY_EventBuffer &events)
+    {
+        for (const SDL_Event &event : events)
+        {
+            handleEvent(&event);
+        }
+    }
 };
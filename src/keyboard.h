@@ -1,59 +1,143 @@
 // Reference:
 // https://www.falukdevelop.com/2016/08/18/simple-sdl-2-keyboard-key-status/
+//
+// Key states are kept as bits, one per scancode (512 bits = 8 words).
+// update() packs SDL's keyboard state once per frame and works out which keys
+// were pressed or released with a few word-wide XOR/ANDs, so every query
+// afterwards is a single bit test. Keycode queries go through a cached
+// keycode -> scancode table instead of asking SDL each time.
+
+#pragma once
 
 #include <SDL2/SDL.h>
 #include <stdio.h>
 #include <string>
 #include <map>
 
+#include "events.h"
+
+#define WY_KEY_WORDS (SDL_NUM_SCANCODES / 64)
+
 class WY_Keyboard
 {
-    Uint8 prevKeystate[SDL_NUM_SCANCODES];
-    Uint8 currKeystate[SDL_NUM_SCANCODES];
+    Uint64 mDown[WY_KEY_WORDS];
+    Uint64 mPrevDown[WY_KEY_WORDS];
+    Uint64 mPressed[WY_KEY_WORDS];  // down this frame, up last frame
+    Uint64 mReleased[WY_KEY_WORDS]; // up this frame, down last frame
+    bool bAnyDown = false;
+    bool bAnyPressed = false;
     unsigned char charPressed;
 
+    // Scancodes of keycodes 0-255 (the character keys); others are looked up in SDL
+    SDL_Scancode mScancodes[256];
+
+    static bool testBit(const Uint64 *bits, SDL_Scancode code)
+    {
+        return (unsigned)code < SDL_NUM_SCANCODES && (bits[code >> 6] >> (code & 63)) & 1;
+    }
+
+    // Must be refreshed when the keyboard layout changes
+    void buildScancodeTable()
+    {
+        for (int key = 0; key < 256; key++)
+        {
+            mScancodes[key] = SDL_GetScancodeFromKey(key);
+        }
+    }
+
+    SDL_Scancode toScancode(SDL_Keycode keycode)
+    {
+        if (keycode >= 0 && keycode < 256)
+        {
+            return mScancodes[keycode];
+        }
+
+        return SDL_GetScancodeFromKey(keycode);
+    }
+
+    // Packs SDL's byte-per-key state into bits
+    void readState()
+    {
+        const Uint8 *state = SDL_GetKeyboardState(NULL);
+
+        for (int w = 0; w < WY_KEY_WORDS; w++)
+        {
+            Uint64 word = 0;
+            for (int b = 0; b < 64; b++)
+            {
+                word |= (Uint64)(state[w * 64 + b] != 0) << b;
+            }
+            mDown[w] = word;
+        }
+    }
+
 public:
     WY_Keyboard()
     {
-        memset(prevKeystate, 0, sizeof(Uint8) * SDL_NUM_SCANCODES);
-        memcpy(currKeystate, SDL_GetKeyboardState(NULL), sizeof(Uint8) * SDL_NUM_SCANCODES);
+        buildScancodeTable();
+        readState();
+
+        memset(mPrevDown, 0, sizeof(mPrevDown));
+        memset(mPressed, 0, sizeof(mPressed));
+        memset(mReleased, 0, sizeof(mReleased));
     }
 
+    // ==================================================
+    // Keycode queries (SDLK_*)
+    // ==================================================
+
     bool isKeyPressed(const SDL_Keycode keycode)
     {
-        SDL_Scancode code = SDL_GetScancodeFromKey(keycode);
-        return (prevKeystate[code] == 0 && currKeystate[code] == 1);
+        return testBit(mPressed, toScancode(keycode));
     }
 
     bool isKeyReleased(const SDL_Keycode keycode)
     {
-        SDL_Scancode code = SDL_GetScancodeFromKey(keycode);
-        return (prevKeystate[code] == 1 && currKeystate[code] == 0);
+        return testBit(mReleased, toScancode(keycode));
     }
 
     bool isKeyDown(const SDL_Keycode keycode)
     {
-        SDL_Scancode code = SDL_GetScancodeFromKey(keycode);
-        return (currKeystate[code] == 1);
+        return testBit(mDown, toScancode(keycode));
     }
 
     bool isKeyUp(const SDL_Keycode keycode)
     {
-        SDL_Scancode code = SDL_GetScancodeFromKey(keycode);
-        return (currKeystate[code] == 0);
+        return !testBit(mDown, toScancode(keycode));
+    }
+
+    // ==================================================
+    // Scancode queries (SDL_SCANCODE_*), physical key positions
+    // ==================================================
+
+    bool isScancodePressed(SDL_Scancode code)
+    {
+        return testBit(mPressed, code);
+    }
+
+    bool isScancodeReleased(SDL_Scancode code)
+    {
+        return testBit(mReleased, code);
+    }
+
+    bool isScancodeDown(SDL_Scancode code)
+    {
+        return testBit(mDown, code);
+    }
+
+    bool isScancodeUp(SDL_Scancode code)
+    {
+        return !testBit(mDown, code);
     }
 
     bool isAnyKeyDown()
     {
-        for (int i = 0; i < SDL_NUM_SCANCODES; i++)
-        {
-            if (currKeystate[i] == 1)
-            {
-                return true;
-            }
-        }
+        return bAnyDown;
+    }
 
-        return false;
+    bool isAnyKeyPressed()
+    {
+        return bAnyPressed;
     }
 
     char getLastCharPressed()
@@ -61,23 +145,50 @@ public:
         return charPressed;
     }
 
-    void update(SDL_Event *windowEvent)
+    // Which scancodes are down, as WY_KEY_WORDS words (for WY_InputLog)
+    const Uint64 *getState()
+    {
+        return mDown;
+    }
+
+    // Call once per frame, after the frame's events were polled. state
+    // replaces SDL's keyboard state, e.g. when replaying recorded input.
+    void update(const WY_EventBuffer &events, const Uint64 *state = NULL)
     {
-        if (windowEvent->key.repeat == 1)
+        memcpy(mPrevDown, mDown, sizeof(mDown));
+        if (state != NULL)
         {
-            return;
+            memcpy(mDown, state, sizeof(mDown));
+        }
+        else
+        {
+            readState();
         }
 
-        memcpy(prevKeystate, currKeystate, sizeof(Uint8) * SDL_NUM_SCANCODES);
-        memcpy(currKeystate, SDL_GetKeyboardState(NULL), sizeof(Uint8) * SDL_NUM_SCANCODES);
-
-        if (windowEvent->type == SDL_KEYDOWN)
+        Uint64 anyDown = 0, anyPressed = 0;
+        for (int w = 0; w < WY_KEY_WORDS; w++)
         {
-            int keycode = windowEvent->key.keysym.sym;
-            SDL_TextInputEvent keytext = windowEvent->text;
+            Uint64 changed = mDown[w] ^ mPrevDown[w];
+            mPressed[w] = changed & mDown[w];
+            mReleased[w] = changed & mPrevDown[w];
 
-            // capitalized chars are handled as input-text in WY_IO
-            charPressed = keycode;
+            anyDown |= mDown[w];
+            anyPressed |= mPressed[w];
+        }
+        bAnyDown = anyDown != 0;
+        bAnyPressed = anyPressed != 0;
+
+        for (const SDL_Event &event : events)
+        {
+            if (event.type == SDL_KEYDOWN && event.key.repeat == 0)
+            {
+                // capitalized chars are handled as input-text in WY_IO
+                charPressed = event.key.keysym.sym;
+            }
+            else if (event.type == SDL_KEYMAPCHANGED)
+            {
+                buildScancodeTable();
+            }
         }
     }
-};
\ No newline at end of file
+};
@@ -12,11 +12,74 @@
 #include "Binasc.h"
 
 #include <sstream>
+#include <iterator>
+#include <string.h>
 #include <stdlib.h>
 
 
 namespace smf {
 
+//////////////////////////////
+//
+// BinascByteBuffer -- stream buffer which appends everything written to it
+//     onto a byte vector.  Used so that the word processing functions which
+//     write to an ostream can share the output of the buffer-based
+//     writeToBinary() without going through a stringstream.
+//
+
+class BinascByteBuffer : public std::streambuf {
+	public:
+		BinascByteBuffer(std::vector<uchar>& data) : m_data(data) { }
+
+	protected:
+		int_type overflow(int_type ch) {
+			if (ch != traits_type::eof()) {
+				m_data.push_back((uchar)ch);
+			}
+			return traits_type::not_eof(ch);
+		}
+
+		std::streamsize xsputn(const char* s, std::streamsize count) {
+			m_data.insert(m_data.end(), s, s + count);
+			return count;
+		}
+
+	private:
+		std::vector<uchar>& m_data;
+};
+
+
+//////////////////////////////
+//
+// readDecimalDigits -- atoi() for the fast paths in processLine(), which
+//     have already checked that the word starts with a digit.
+//
+
+static ulong readDecimalDigits(const char* digits) {
+	ulong value = 0;
+	while (isdigit(*digits)) {
+		value = value * 10 + (*digits - '0');
+		digits++;
+	}
+	return value;
+}
+
+
+
+//////////////////////////////
+//
+// readHexDigit -- value of a single character already checked by isxdigit().
+//
+
+static uchar readHexDigit(char digit) {
+	if (digit <= '9') {
+		return digit - '0';
+	}
+	return (digit | 0x20) - 'a' + 10;
+}
+
+
+
 //////////////////////////////
 //
 // Binasc::Binasc -- Constructor: set the default option values.
@@ -262,18 +325,42 @@ int Binasc::writeToBinary(std::ostream& out, const std::string& infile) {
 
 
 int Binasc::writeToBinary(std::ostream& out, std::istream& input) {
-	char inputLine[1024] = {0};    // current line being processed
-	int  lineNum = 0;              // current line number
+	std::string data((std::istreambuf_iterator<char>(input)),
+			std::istreambuf_iterator<char>());
+	std::vector<uchar> bytes;
+	int status = writeToBinary(bytes, data.data(), (int)data.size());
+	out.write((const char*)bytes.data(), bytes.size());
+	return status;
+}
 
-	input.getline(inputLine, 1024, '\n');
-	lineNum++;
-	while (!input.eof()) {
-		int status = processLine(out, inputLine, lineNum);
+
+//
+// Buffer version of writeToBinary(): lines are processed in place and the
+// bytes are appended to the output vector, so there is no line copying and
+// no intermediate stream.
+//
+
+int Binasc::writeToBinary(std::vector<uchar>& out, const char* input,
+		int length) {
+	BinascByteBuffer buffer(out);
+	std::ostream wordout(&buffer);
+	int lineNum = 0;               // current line number
+	int start = 0;                 // start of current line
+
+	// binasc text uses at least two characters per byte
+	out.reserve(out.size() + length / 2);
+
+	while (start < length) {
+		const char* newline = (const char*)memchr(input + start, '\n',
+				length - start);
+		int end = newline ? (int)(newline - input) : length;
+		lineNum++;
+		int status = processLine(out, wordout, input + start, end - start,
+				lineNum);
 		if (!status) {
 			return 0;
 		}
-		input.getline(inputLine, 1024, '\n');
-		lineNum++;
+		start = end + 1;
 	}
 	return 1;
 }
@@ -506,14 +593,17 @@ int Binasc::outputStyleBoth(std::ostream& out, std::istream& input) {
 
 ///////////////////////////////
 //
-// processLine -- read a line of input and output any specified bytes
+// processLine -- read a line of input and output any specified bytes.
+//    Hexadecimal, VLV, string and plain decimal bytes are the bulk of
+//    binasc MIDI data, so they are appended to out directly; every other
+//    word goes through its process*Word function via wordout, which must
+//    write to the end of out.
 //
 
-int Binasc::processLine(std::ostream& out, const std::string& input,
-		int lineCount) {
+int Binasc::processLine(std::vector<uchar>& out, std::ostream& wordout,
+		const char* input, int length, int lineCount) {
 	int status = 1;
 	int i = 0;
-	int length = (int)input.size();
 	std::string word;
 	while (i<length) {
 		if ((input[i] == ';') || (input[i] == '#') || (input[i] == '/')) {
@@ -525,29 +615,60 @@ int Binasc::processLine(std::ostream& out, const std::string& input,
 			i++;
 			continue;
 		} else if (input[i] == '+') {
-			i = getWord(word, input, " \n\t", i);
-			status = processAsciiWord(out, word, lineCount);
+			i = getWord(word, input, length, " \n\t", i);
+			status = processAsciiWord(wordout, word, lineCount);
 		} else if (input[i] == '"') {
-			i = getWord(word, input, "\"", i);
-			status = processStringWord(out, word, lineCount);
+			i = getWord(word, input, length, "\"", i);
+			out.insert(out.end(), word.begin(), word.end());
 		} else if (input[i] == 'v') {
-			i = getWord(word, input, " \n\t", i);
-			status = processVlvWord(out, word, lineCount);
+			i = getWord(word, input, length, " \n\t", i);
+			if (word.size() < 2 || !isdigit(word[1])) {
+				// let processVlvWord report the error
+				status = processVlvWord(wordout, word, lineCount);
+			} else {
+				ulong value = readDecimalDigits(&word[1]);
+				int shift = 28;
+				while (shift > 0 && ((value >> shift) & 0x7f) == 0) {
+					shift -= 7;
+				}
+				for (; shift > 0; shift -= 7) {
+					out.push_back((uchar)(((value >> shift) & 0x7f) | 0x80));
+				}
+				out.push_back((uchar)(value & 0x7f));
+			}
 		} else if (input[i] == 'p') {
-			i = getWord(word, input, " \n\t", i);
-			status = processMidiPitchBendWord(out, word, lineCount);
+			i = getWord(word, input, length, " \n\t", i);
+			status = processMidiPitchBendWord(wordout, word, lineCount);
 		} else if (input[i] == 't') {
-			i = getWord(word, input, " \n\t", i);
-			status = processMidiTempoWord(out, word, lineCount);
+			i = getWord(word, input, length, " \n\t", i);
+			status = processMidiTempoWord(wordout, word, lineCount);
 		} else {
-			i = getWord(word, input, " \n\t", i);
+			i = getWord(word, input, length, " \n\t", i);
 			if (word.find('\'') != std::string::npos) {
-				status = processDecimalWord(out, word, lineCount);
+				// plain one-byte unsigned decimal such as '60
+				int digits = (int)word.size() > 1 && (int)word.size() <= 4
+						&& word[0] == '\'';
+				for (int j=1; digits && j<(int)word.size(); j++) {
+					digits = isdigit(word[j]);
+				}
+				ulong value = digits ? readDecimalDigits(&word[1]) : 256;
+				if (value <= 255) {
+					out.push_back((uchar)value);
+				} else {
+					status = processDecimalWord(wordout, word, lineCount);
+				}
 			} else if ((word.find(',') != std::string::npos)
 					|| (word.size() > 2)) {
-				status = processBinaryWord(out, word, lineCount);
+				status = processBinaryWord(wordout, word, lineCount);
+			} else if (isxdigit(word[0])
+					&& (word.size() == 1 || isxdigit(word[1]))) {
+				uchar value = readHexDigit(word[0]);
+				if (word.size() == 2) {
+					value = (value << 4) | readHexDigit(word[1]);
+				}
+				out.push_back(value);
 			} else {
-				status = processHexWord(out, word, lineCount);
+				status = processHexWord(wordout, word, lineCount);
 			}
 		}
 
@@ -568,16 +689,25 @@ int Binasc::processLine(std::ostream& out, const std::string& input,
 //   terminator characters.
 //
 
-int Binasc::getWord(std::string& word, const std::string& input,
-		const std::string& terminators, int index) {
+int Binasc::getWord(std::string& word, const char* input, int length,
+		const char* terminators, int index) {
 	word.resize(0);
 	int i = index;
 	int escape = 0;
 	int ecount = 0;
-	if (terminators.find('"') != std::string::npos) {
+	if (strchr(terminators, '"') != NULL) {
 		escape = 1;
 	}
-	while (i < (int)input.size()) {
+	if (!escape) {
+		// no escapes possible, so copy the whole word at once
+		while ((i < length) && (input[i] == '\0'
+				|| strchr(terminators, input[i]) == NULL)) {
+			i++;
+		}
+		word.assign(input + index, i - index);
+		return i < length ? i + 1 : i;
+	}
+	while (i < length) {
 		if (escape && input[i] == '\"') {
 			ecount++;
 			i++;
@@ -585,11 +715,12 @@ int Binasc::getWord(std::string& word, const std::string& input,
 				break;
 			}
 		}
-		if (escape && (i<(int)input.size()-1) && (input[i] == '\\')
+		if (escape && (i<length-1) && (input[i] == '\\')
 				&& (input[i+1] == '"')) {
 			word.push_back(input[i+1]);
 			i += 2;
-		} else if (terminators.find(input[i]) == std::string::npos) {
+		} else if ((i < length) && (input[i] == '\0'
+				|| strchr(terminators, input[i]) == NULL)) {
 			word.push_back(input[i]);
 			i++;
 		} else {
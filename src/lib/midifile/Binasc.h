@@ -16,6 +16,7 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
 #include <cstdlib>
 #include <stdlib.h> /* needed for MinGW */
 
@@ -59,6 +60,9 @@ class Binasc {
 		                                              const std::string& infile);
 		int                  writeToBinary           (std::ostream& out,
 		                                              std::istream& input);
+		int                  writeToBinary           (std::vector<uchar>& out,
+		                                              const char* input,
+		                                              int length);
 
 		// functions for converting into an ASCII file with hex bytes:
 		int                  readFromBinary          (const std::string&
@@ -108,9 +112,10 @@ class Binasc {
 
 	private:
 		// helper functions for reading ASCII content to conver to binary:
-		int                  processLine             (std::ostream& out,
-		                                              const std::string& input,
-		                                              int lineNum);
+		int                  processLine             (std::vector<uchar>& out,
+		                                              std::ostream& wordout,
+		                                              const char* input,
+		                                              int length, int lineNum);
 		int                  processAsciiWord        (std::ostream& out,
 		                                              const std::string& input,
 		                                              int lineNum);
@@ -146,8 +151,9 @@ class Binasc {
 		int  readMidiEvent  (std::ostream& out, std::istream& infile,
 		                     int& trackbytes, int& command);
 		int  getVLV         (std::istream& infile, int& trackbytes);
-		int  getWord        (std::string& word, const std::string& input,
-		                     const std::string& terminators, int index);
+		int  getWord        (std::string& word, const char* input,
+		                     int length, const char* terminators,
+		                     int index);
 
 };
 
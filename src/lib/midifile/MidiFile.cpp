@@ -27,6 +27,23 @@
 
 namespace smf {
 
+//////////////////////////////
+//
+// MidiFileMemoryBuffer -- read-only stream buffer over bytes already in
+//     memory, so that they can be parsed by read(std::istream&) without
+//     being copied into a stringstream first.
+//
+
+class MidiFileMemoryBuffer : public std::streambuf {
+	public:
+		MidiFileMemoryBuffer(const char* data, int size) {
+			char* begin = const_cast<char*>(data);
+			setg(begin, begin, begin + size);
+		}
+};
+
+
+
 //////////////////////////////
 //
 // MidiFile::MidiFile -- Constuctor.
@@ -174,23 +191,20 @@ bool MidiFile::read(const std::string& filename) {
 
 bool MidiFile::read(std::istream& input) {
 	m_rwstatus = true;
+	if (input.peek() == EOF) {
+		std::cerr << "Bad MIDI data input" << std::endl;
+		m_rwstatus = false;
+		return m_rwstatus;
+	}
 	if (input.peek() != 'M') {
 		// If the first byte in the input stream is not 'M', then presume that
 		// the MIDI file is in the binasc format which is an ASCII representation
 		// of the MIDI file.  Convert the binasc content into binary content and
 		// then continue reading with this function.
-		std::stringstream binarydata;
-		Binasc binasc;
-		binasc.writeToBinary(binarydata, input);
-		binarydata.seekg(0, std::ios_base::beg);
-		if (binarydata.peek() != 'M') {
-			std::cerr << "Bad MIDI data input" << std::endl;
-			m_rwstatus = false;
-			return m_rwstatus;
-		} else {
-			m_rwstatus = read(binarydata);
-			return m_rwstatus;
-		}
+		std::string asciidata((std::istreambuf_iterator<char>(input)),
+				std::istreambuf_iterator<char>());
+		m_rwstatus = read(asciidata.data(), (int)asciidata.size());
+		return m_rwstatus;
 	}
 
 	std::string filename = getFilename();
@@ -459,6 +473,44 @@ bool MidiFile::read(std::istream& input) {
 
 
 
+//////////////////////////////
+//
+// MidiFile::read -- Parse a Standard MIDI File (binary or binasc) that is
+//      already in memory.  Binasc content is decoded straight into a byte
+//      array which is then parsed in place.
+//
+
+bool MidiFile::read(const char* data, int size) {
+	m_rwstatus = true;
+	if (size <= 0) {
+		std::cerr << "Bad MIDI data input" << std::endl;
+		m_rwstatus = false;
+		return m_rwstatus;
+	}
+	if (data[0] != 'M') {
+		std::vector<uchar> binarydata;
+		Binasc binasc;
+		binasc.writeToBinary(binarydata, data, size);
+		if (binarydata.empty() || binarydata[0] != 'M') {
+			std::cerr << "Bad MIDI data input" << std::endl;
+			m_rwstatus = false;
+			return m_rwstatus;
+		}
+		MidiFileMemoryBuffer buffer((const char*)binarydata.data(),
+				(int)binarydata.size());
+		std::istream binaryinput(&buffer);
+		m_rwstatus = read(binaryinput);
+		return m_rwstatus;
+	}
+
+	MidiFileMemoryBuffer buffer(data, size);
+	std::istream input(&buffer);
+	m_rwstatus = read(input);
+	return m_rwstatus;
+}
+
+
+
 //////////////////////////////
 //
 // MidiFile::write -- write a standard MIDI file to a file or an output
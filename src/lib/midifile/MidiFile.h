@@ -52,6 +52,7 @@ class MidiFile {
 		// reading/writing functions:
 		bool           read                        (const std::string& filename);
 		bool           read                        (std::istream& instream);
+		bool           read                        (const char* data, int size);
 		bool           write                       (const std::string& filename);
 		bool           write                       (std::ostream& out);
 		bool           writeHex                    (const std::string& filename,
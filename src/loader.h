@@ -0,0 +1,290 @@
+// Asynchronous image loading
+//
+// PNG decoding, format conversion and color keying run on a small pool of
+// worker threads. Decoded surfaces are queued and turned into textures by
+// update() on the main thread, which owns the renderer, spending at most a
+// given number of ms per frame so a level load never stalls the game loop.
+//
+// On web builds (no threads) the decoding also happens in update().
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "image.h"
+#include "assets.h"
+
+enum WY_LoadState
+{
+    LOAD_PENDING, // queued or decoding
+    LOAD_READY,   // texture uploaded, get() returns the image
+    LOAD_FAILED
+};
+
+struct WY_ImageRequest
+{
+    std::string path;
+    WY_LoadState state = LOAD_PENDING;
+    WY_ImageHandle image;
+
+    // Filled in by the worker
+    SDL_Surface *surface = nullptr;
+    double dDecodeTime = 0.0;
+
+    bool isReady()
+    {
+        return state == LOAD_READY;
+    }
+
+    bool isFailed()
+    {
+        return state == LOAD_FAILED;
+    }
+
+    bool isDone()
+    {
+        return state != LOAD_PENDING;
+    }
+
+    // Empty until the request is ready
+    WY_ImageHandle get()
+    {
+        return image;
+    }
+};
+
+// Poll isReady()/isDone() once per frame; only the main thread changes the state.
+typedef std::shared_ptr<WY_ImageRequest> WY_ImageFuture;
+
+int imageLoaderThread(void *data);
+
+class WY_ImageLoader
+{
+    WY_AssetCache *mCache;
+    double dUploadBudget; // ms per frame spent uploading textures
+
+    std::vector<SDL_Thread *> mThreads;
+    SDL_mutex *muxQueue;
+    SDL_cond *cndQueue;
+    bool bQuit = false;
+
+    std::deque<WY_ImageFuture> mQueued;  // waiting for a worker
+    std::deque<WY_ImageFuture> mDecoded; // waiting for upload
+    std::unordered_map<std::string, WY_ImageFuture> mPending;
+
+    static double elapsed(Uint64 nStart)
+    {
+        return (SDL_GetPerformanceCounter() - nStart) * 1000.0 / SDL_GetPerformanceFrequency();
+    }
+
+    static void decode(WY_ImageRequest *request)
+    {
+        Uint64 nStart = SDL_GetPerformanceCounter();
+        request->surface = decodePNG(request->path);
+        request->dDecodeTime = elapsed(nStart);
+    }
+
+    void upload(WY_ImageFuture &request)
+    {
+        Uint64 nStart = SDL_GetPerformanceCounter();
+        WY_Image *newImage = uploadImage(mCache->getRenderer(), request->surface, request->path);
+        double dLoadTime = request->dDecodeTime + elapsed(nStart);
+
+        if (request->surface != nullptr)
+        {
+            SDL_FreeSurface(request->surface);
+            request->surface = nullptr;
+        }
+
+        request->image = mCache->addImage(request->path, newImage, dLoadTime);
+        request->state = request->image->texture != NULL ? LOAD_READY : LOAD_FAILED;
+
+        mPending.erase(request->path);
+    }
+
+public:
+    // threads = 0 decodes on the main thread inside update()
+    WY_ImageLoader(WY_AssetCache *cache, int threads = 2, double uploadBudget = 2.0)
+    {
+        mCache = cache;
+        dUploadBudget = uploadBudget;
+
+        muxQueue = SDL_CreateMutex();
+        cndQueue = SDL_CreateCond();
+
+#ifdef __EMSCRIPTEN__
+        threads = 0;
+#endif
+
+        for (int i = 0; i < threads; i++)
+        {
+            SDL_Thread *thread = SDL_CreateThread(imageLoaderThread, "WY_ImageLoader", this);
+            if (thread == NULL)
+            {
+                SDL_Log("Unable to create image loader thread! SDL_Error: %s\n", SDL_GetError());
+                break;
+            }
+            mThreads.push_back(thread);
+        }
+    }
+
+    ~WY_ImageLoader()
+    {
+        SDL_LockMutex(muxQueue);
+        bQuit = true;
+        SDL_CondBroadcast(cndQueue);
+        SDL_UnlockMutex(muxQueue);
+
+        for (auto thread : mThreads)
+        {
+            SDL_WaitThread(thread, NULL);
+        }
+
+        for (auto &request : mDecoded)
+        {
+            if (request->surface != nullptr)
+            {
+                SDL_FreeSurface(request->surface);
+            }
+        }
+
+        SDL_DestroyCond(cndQueue);
+        SDL_DestroyMutex(muxQueue);
+    }
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    // Requests not yet uploaded
+    int getPendingCount()
+    {
+        return mPending.size();
+    }
+
+    double getUploadBudget()
+    {
+        return dUploadBudget;
+    }
+
+    // ==================================================
+    // Setters
+    // ==================================================
+
+    void setUploadBudget(double ms)
+    {
+        dUploadBudget = ms;
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    // Queues an image for loading. Cached images come back ready immediately,
+    // and loading the same path twice returns the same request.
+    WY_ImageFuture load(const std::string &path)
+    {
+        auto pending = mPending.find(path);
+        if (pending != mPending.end())
+        {
+            return pending->second;
+        }
+
+        WY_ImageFuture request = std::make_shared<WY_ImageRequest>();
+        request->path = path;
+
+        request->image = mCache->findImage(path);
+        if (request->image)
+        {
+            request->state = LOAD_READY;
+            return request;
+        }
+
+        mPending[path] = request;
+
+        SDL_LockMutex(muxQueue);
+        mQueued.push_back(request);
+        SDL_CondSignal(cndQueue);
+        SDL_UnlockMutex(muxQueue);
+
+        return request;
+    }
+
+    // Call once per frame from the main thread. Uploads decoded images until
+    // the frame's budget is spent (always at least one, so loading progresses).
+    void update()
+    {
+        Uint64 nStart = SDL_GetPerformanceCounter();
+
+        do
+        {
+            WY_ImageFuture request;
+            bool bDecode = false;
+
+            SDL_LockMutex(muxQueue);
+            if (!mDecoded.empty())
+            {
+                request = mDecoded.front();
+                mDecoded.pop_front();
+            }
+            else if (mThreads.empty() && !mQueued.empty())
+            {
+                // No workers: decode here, within the same budget
+                request = mQueued.front();
+                mQueued.pop_front();
+                bDecode = true;
+            }
+            SDL_UnlockMutex(muxQueue);
+
+            if (!request)
+            {
+                break;
+            }
+
+            if (bDecode)
+            {
+                decode(request.get());
+            }
+
+            upload(request);
+        } while (elapsed(nStart) < dUploadBudget);
+    }
+
+    // Used by the worker threads. Do not call this.
+    void work()
+    {
+        SDL_LockMutex(muxQueue);
+
+        while (!bQuit)
+        {
+            if (mQueued.empty())
+            {
+                SDL_CondWait(cndQueue, muxQueue);
+                continue;
+            }
+
+            WY_ImageFuture request = mQueued.front();
+            mQueued.pop_front();
+
+            SDL_UnlockMutex(muxQueue);
+            decode(request.get());
+            SDL_LockMutex(muxQueue);
+
+            mDecoded.push_back(request);
+        }
+
+        SDL_UnlockMutex(muxQueue);
+    }
+};
+
+// SDL threads only take plain functions, hence the intermediary
+int imageLoaderThread(void *data)
+{
+    static_cast<WY_ImageLoader *>(data)->work();
+    return 0;
+}
@@ -0,0 +1,458 @@
+// Particles
+//
+// A fixed-capacity pool of particles kept as one array per field (x, y,
+// velocity, ...), so the update is a straight pass over contiguous floats
+// that the SSE2/AVX2 kernels below chew through 4 or 8 particles at a time.
+// Dead particles are swap-removed, so the live ones always sit at the front
+// and nothing is allocated after construction.
+//
+// Particles come from emitters, which describe where particles spawn, how
+// many per second, how long they live, how fast they go and how their color
+// and alpha change over their life. All particles are drawn with a single
+// SDL_RenderGeometry call.
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <vector>
+
+#include "image.h"
+#include "camera.h"
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+#define WY_PARTICLE_GEOMETRY
+#endif
+
+struct WY_Emitter
+{
+    SDL_FRect area{0, 0, 0, 0}; // particles spawn anywhere inside (a point if w = h = 0)
+    float fRate = 100.0f;       // particles per second, 0 for burst() only
+    float fLifeMin = 1.0f;      // in seconds
+    float fLifeMax = 1.0f;
+    float fVelXMin = 0.0f; // in pixels per second
+    float fVelXMax = 0.0f;
+    float fVelYMin = 0.0f;
+    float fVelYMax = 0.0f;
+    float fGravity = 0.0f; // in pixels per second per second, downwards
+    float fSize = 4.0f;    // in pixels
+    SDL_Color colorStart{0xFF, 0xFF, 0xFF, 0xFF};
+    SDL_Color colorEnd{0xFF, 0xFF, 0xFF, 0x00}; // faded out by default
+    bool bActive = true;
+
+    float fPending = 0.0f; // fraction of a particle carried over to the next update
+};
+
+struct WY_ParticleStats
+{
+    int nAlive = 0;
+    int nSpawned = 0; // in the last update
+    int nDied = 0;    // in the last update
+    int nDropped = 0; // spawns skipped in the last update because the pool was full
+};
+
+// ==================================================
+// Update kernels
+// ==================================================
+//
+// Moves count particles by dt seconds and ages them. t is each particle's
+// age as a fraction of its lifetime (dead at 1) and rate is 1 / lifetime.
+
+typedef void (*WY_ParticleKernel)(float *x, float *y, float *vx, float *vy, const float *ay, float *t, const float *rate, int count, float dt);
+
+void updateParticlesScalar(float *x, float *y, float *vx, float *vy, const float *ay, float *t, const float *rate, int count, float dt)
+{
+    for (int i = 0; i < count; i++)
+    {
+        vy[i] += ay[i] * dt;
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+        t[i] += rate[i] * dt;
+    }
+}
+
+#ifdef WY_IMAGE_X86
+WY_TARGET("sse2")
+void updateParticlesSSE2(float *x, float *y, float *vx, float *vy, const float *ay, float *t, const float *rate, int count, float dt)
+{
+    __m128 step = _mm_set1_ps(dt);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 velY = _mm_add_ps(_mm_loadu_ps(vy + i), _mm_mul_ps(_mm_loadu_ps(ay + i), step));
+        _mm_storeu_ps(vy + i, velY);
+        _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(_mm_loadu_ps(vx + i), step)));
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(velY, step)));
+        _mm_storeu_ps(t + i, _mm_add_ps(_mm_loadu_ps(t + i), _mm_mul_ps(_mm_loadu_ps(rate + i), step)));
+    }
+
+    updateParticlesScalar(x + i, y + i, vx + i, vy + i, ay + i, t + i, rate + i, count - i, dt);
+}
+
+WY_TARGET("avx2")
+void updateParticlesAVX2(float *x, float *y, float *vx, float *vy, const float *ay, float *t, const float *rate, int count, float dt)
+{
+    __m256 step = _mm256_set1_ps(dt);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 velY = _mm256_add_ps(_mm256_loadu_ps(vy + i), _mm256_mul_ps(_mm256_loadu_ps(ay + i), step));
+        _mm256_storeu_ps(vy + i, velY);
+        _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(_mm256_loadu_ps(vx + i), step)));
+        _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(velY, step)));
+        _mm256_storeu_ps(t + i, _mm256_add_ps(_mm256_loadu_ps(t + i), _mm256_mul_ps(_mm256_loadu_ps(rate + i), step)));
+    }
+
+    updateParticlesScalar(x + i, y + i, vx + i, vy + i, ay + i, t + i, rate + i, count - i, dt);
+}
+#endif
+
+WY_ParticleKernel getParticleKernel()
+{
+#ifdef WY_IMAGE_X86
+    if (SDL_HasAVX2())
+    {
+        return updateParticlesAVX2;
+    }
+    if (SDL_HasSSE2())
+    {
+        return updateParticlesSSE2;
+    }
+#endif
+    return updateParticlesScalar;
+}
+
+// ==================================================
+// Particle system
+// ==================================================
+
+class WY_ParticleSystem
+{
+    int mCapacity;
+    int nAlive = 0;
+
+    // One entry per particle; only the first nAlive are live
+    std::vector<float> mX, mY, mVX, mVY, mAY, mT, mRate;
+    std::vector<Uint16> mEmitter;
+
+    std::vector<WY_Emitter> mEmitters;
+
+    // Textured quads use sprite.origin of sprite.texture; without a texture they are solid
+    WY_Sprite mSprite{nullptr, nullptr, {0, 0, 0, 0}};
+    SDL_FRect mUV{0, 0, 1, 1};
+
+#ifdef WY_PARTICLE_GEOMETRY
+    std::vector<SDL_Vertex> mVertices; // 4 per particle
+    std::vector<int> mIndices;         // 6 per particle, built once
+#endif
+
+    Uint32 mSeed = 0x2545F491;
+    WY_ParticleStats mStats;
+
+    // xorshift32; rand() is too slow for tens of thousands of spawns a second
+    float random(float min, float max)
+    {
+        mSeed ^= mSeed << 13;
+        mSeed ^= mSeed >> 17;
+        mSeed ^= mSeed << 5;
+        return min + (max - min) * ((mSeed >> 8) * (1.0f / 16777216.0f));
+    }
+
+    void spawn(int emitter)
+    {
+        if (nAlive >= mCapacity)
+        {
+            mStats.nDropped++;
+            return;
+        }
+
+        WY_Emitter &e = mEmitters[emitter];
+        int i = nAlive++;
+
+        mX[i] = random(e.area.x, e.area.x + e.area.w);
+        mY[i] = random(e.area.y, e.area.y + e.area.h);
+        mVX[i] = random(e.fVelXMin, e.fVelXMax);
+        mVY[i] = random(e.fVelYMin, e.fVelYMax);
+        mAY[i] = e.fGravity;
+        mT[i] = 0.0f;
+        mRate[i] = 1.0f / std::max(random(e.fLifeMin, e.fLifeMax), 0.001f);
+        mEmitter[i] = emitter;
+
+        mStats.nSpawned++;
+    }
+
+    // Moves the last live particle into slot i
+    void kill(int i)
+    {
+        int last = --nAlive;
+
+        mX[i] = mX[last];
+        mY[i] = mY[last];
+        mVX[i] = mVX[last];
+        mVY[i] = mVY[last];
+        mAY[i] = mAY[last];
+        mT[i] = mT[last];
+        mRate[i] = mRate[last];
+        mEmitter[i] = mEmitter[last];
+
+        mStats.nDied++;
+    }
+
+    static Uint8 lerp(Uint8 a, Uint8 b, float t)
+    {
+        return (Uint8)(a + (b - a) * t);
+    }
+
+public:
+    WY_ParticleSystem(int capacity)
+    {
+        mCapacity = capacity;
+
+        mX.resize(capacity);
+        mY.resize(capacity);
+        mVX.resize(capacity);
+        mVY.resize(capacity);
+        mAY.resize(capacity);
+        mT.resize(capacity);
+        mRate.resize(capacity);
+        mEmitter.resize(capacity);
+
+#ifdef WY_PARTICLE_GEOMETRY
+        mVertices.resize(capacity * 4);
+        mIndices.resize(capacity * 6);
+        for (int i = 0; i < capacity; i++)
+        {
+            int *quad = mIndices.data() + i * 6;
+            quad[0] = i * 4;
+            quad[1] = i * 4 + 1;
+            quad[2] = i * 4 + 2;
+            quad[3] = i * 4 + 2;
+            quad[4] = i * 4 + 1;
+            quad[5] = i * 4 + 3;
+        }
+#endif
+    }
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    int getCount()
+    {
+        return nAlive;
+    }
+
+    int getCapacity()
+    {
+        return mCapacity;
+    }
+
+    // NULL if there is no such emitter. Changes apply to particles spawned afterwards.
+    WY_Emitter *getEmitter(int emitter)
+    {
+        if (emitter < 0 || emitter >= (int)mEmitters.size())
+        {
+            return NULL;
+        }
+
+        return &mEmitters[emitter];
+    }
+
+    const WY_ParticleStats &getStats()
+    {
+        return mStats;
+    }
+
+    // ==================================================
+    // Setters
+    // ==================================================
+
+    // Draws every particle as this sprite, tinted by its color (e.g. a white
+    // blob from WY_Atlas). A sprite without a texture draws solid squares.
+    void setSprite(WY_Sprite sprite)
+    {
+        mSprite = sprite;
+        mUV = {0, 0, 1, 1};
+
+        int w, h;
+        if (sprite.texture != nullptr && SDL_QueryTexture(sprite.texture, NULL, NULL, &w, &h) == 0 && w > 0 && h > 0)
+        {
+            if (sprite.origin.w == 0 || sprite.origin.h == 0)
+            {
+                mSprite.origin = {0, 0, w, h};
+            }
+
+            mUV = {(float)mSprite.origin.x / w, (float)mSprite.origin.y / h, (float)mSprite.origin.w / w, (float)mSprite.origin.h / h};
+        }
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    // Returns the emitter's id, for getEmitter() and burst()
+    int addEmitter(const WY_Emitter &emitter)
+    {
+        if (mEmitters.size() >= 0xFFFF)
+        {
+            SDL_Log("Too many particle emitters!\n");
+            return -1;
+        }
+
+        mEmitters.push_back(emitter);
+        return mEmitters.size() - 1;
+    }
+
+    // Spawns count particles from an emitter right away, e.g. for explosions
+    void burst(int emitter, int count)
+    {
+        if (getEmitter(emitter) == NULL)
+        {
+            return;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            spawn(emitter);
+        }
+    }
+
+    // Advances every particle by dt seconds, removes the dead ones and spawns new ones
+    void update(float dt)
+    {
+        static const WY_ParticleKernel updateParticles = getParticleKernel();
+
+        mStats.nSpawned = 0;
+        mStats.nDied = 0;
+        mStats.nDropped = 0;
+
+        updateParticles(mX.data(), mY.data(), mVX.data(), mVY.data(), mAY.data(), mT.data(), mRate.data(), nAlive, dt);
+
+        for (int i = 0; i < nAlive;)
+        {
+            if (mT[i] >= 1.0f)
+            {
+                kill(i); // i now holds a particle that hasn't been checked yet
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        for (size_t e = 0; e < mEmitters.size(); e++)
+        {
+            WY_Emitter &emitter = mEmitters[e];
+            if (!emitter.bActive || emitter.fRate <= 0.0f)
+            {
+                continue;
+            }
+
+            emitter.fPending += emitter.fRate * dt;
+            int count = (int)emitter.fPending;
+            emitter.fPending -= count;
+
+            for (int i = 0; i < count; i++)
+            {
+                spawn(e);
+            }
+        }
+
+        mStats.nAlive = nAlive;
+    }
+
+    // Draws every live particle, through camera if given
+    void draw(SDL_Renderer *renderer, WY_Camera *camera = nullptr)
+    {
+        float camX = 0.0f, camY = 0.0f, zoom = 1.0f;
+        if (camera != nullptr)
+        {
+            camX = camera->getX();
+            camY = camera->getY();
+            zoom = camera->getZoom();
+        }
+
+        // Without a texture both paths use the draw blend mode, which needs
+        // to be BLEND for the alpha fade; the caller's mode is restored after
+        SDL_BlendMode blendMode;
+        SDL_GetRenderDrawBlendMode(renderer, &blendMode);
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+
+#ifdef WY_PARTICLE_GEOMETRY
+        for (int i = 0; i < nAlive; i++)
+        {
+            WY_Emitter &e = mEmitters[mEmitter[i]];
+            float t = mT[i];
+            float size = e.fSize * zoom;
+            float x0 = (mX[i] - camX) * zoom - size * 0.5f;
+            float y0 = (mY[i] - camY) * zoom - size * 0.5f;
+
+            SDL_Color color = {
+                lerp(e.colorStart.r, e.colorEnd.r, t),
+                lerp(e.colorStart.g, e.colorEnd.g, t),
+                lerp(e.colorStart.b, e.colorEnd.b, t),
+                lerp(e.colorStart.a, e.colorEnd.a, t)};
+
+            SDL_Vertex *quad = mVertices.data() + i * 4;
+            quad[0] = {{x0, y0}, color, {mUV.x, mUV.y}};
+            quad[1] = {{x0 + size, y0}, color, {mUV.x + mUV.w, mUV.y}};
+            quad[2] = {{x0, y0 + size}, color, {mUV.x, mUV.y + mUV.h}};
+            quad[3] = {{x0 + size, y0 + size}, color, {mUV.x + mUV.w, mUV.y + mUV.h}};
+        }
+
+        if (nAlive > 0)
+        {
+            SDL_RenderGeometry(renderer, mSprite.texture, mVertices.data(), nAlive * 4, mIndices.data(), nAlive * 6);
+        }
+#else
+        for (int i = 0; i < nAlive; i++)
+        {
+            WY_Emitter &e = mEmitters[mEmitter[i]];
+            float t = mT[i];
+            int size = (int)(e.fSize * zoom);
+            SDL_Rect dst = {(int)((mX[i] - camX) * zoom) - size / 2, (int)((mY[i] - camY) * zoom) - size / 2, size, size};
+
+            Uint8 r = lerp(e.colorStart.r, e.colorEnd.r, t);
+            Uint8 g = lerp(e.colorStart.g, e.colorEnd.g, t);
+            Uint8 b = lerp(e.colorStart.b, e.colorEnd.b, t);
+            Uint8 a = lerp(e.colorStart.a, e.colorEnd.a, t);
+
+            if (mSprite.texture != nullptr)
+            {
+                SDL_SetTextureColorMod(mSprite.texture, r, g, b);
+                SDL_SetTextureAlphaMod(mSprite.texture, a);
+                SDL_RenderCopy(renderer, mSprite.texture, &mSprite.origin, &dst);
+            }
+            else
+            {
+                SDL_SetRenderDrawColor(renderer, r, g, b, a);
+                SDL_RenderFillRect(renderer, &dst);
+            }
+        }
+
+        if (mSprite.texture != nullptr)
+        {
+            SDL_SetTextureColorMod(mSprite.texture, 0xFF, 0xFF, 0xFF);
+            SDL_SetTextureAlphaMod(mSprite.texture, 0xFF);
+        }
+#endif
+
+        SDL_SetRenderDrawBlendMode(renderer, blendMode);
+    }
+
+    // Kills every particle; emitters keep running
+    void clear()
+    {
+        nAlive = 0;
+        mStats.nAlive = 0;
+    }
+
+    // Kills every particle and removes every emitter
+    void reset()
+    {
+        clear();
+        mEmitters.clear();
+    }
+};
@@ -0,0 +1,263 @@
+// Render queue
+//
+// Records sprite draws during onRender instead of issuing them right away,
+// then sorts them and submits them in as few draw calls as possible. Each
+// draw gets a 64-bit sort key:
+//
+//   layer (8 bits) | texture (16 bits) | depth (16 bits) | order (24 bits)
+//
+// so layers are drawn bottom to top, and within a layer all draws from the
+// same texture end up next to each other, ordered by depth and then by when
+// they were recorded. Draws in one layer that overlap and must keep their
+// order therefore need different layers (or the same texture).
+//
+// Commands go into a vector that is cleared, not freed, each frame, so after
+// the first few frames recording allocates nothing. The keys are sorted with
+// an LSD radix sort that skips the bytes all keys agree on.
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <unordered_map>
+#include <vector>
+
+#include "image.h"
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+#define WY_QUEUE_GEOMETRY
+#endif
+
+struct WY_RenderQueueStats
+{
+    int nCommands = 0;         // draws recorded in the last flush
+    int nBatches = 0;          // draw calls they were submitted in
+    int nSwitchesUnsorted = 0; // texture changes had they been drawn as recorded
+    int nSwitchesSorted = 0;   // texture changes after sorting
+};
+
+class WY_RenderQueue
+{
+    struct Command
+    {
+        SDL_Texture *texture;
+        SDL_Rect src;
+        SDL_Rect dst;
+        SDL_Color color;
+    };
+
+    SDL_Renderer *mRenderer;
+    std::vector<Command> mCommands;
+    std::vector<Uint64> mKeys, mScratch;
+    std::unordered_map<SDL_Texture *, Uint16> mTextureIds;
+    WY_RenderQueueStats mStats;
+
+#ifdef WY_QUEUE_GEOMETRY
+    std::vector<SDL_Vertex> mVertices;
+    std::vector<int> mIndices; // 6 per quad, grown as needed
+#endif
+
+    Uint16 getTextureId(SDL_Texture *texture)
+    {
+        auto found = mTextureIds.find(texture);
+        if (found != mTextureIds.end())
+        {
+            return found->second;
+        }
+
+        // Ids only order textures against each other; running out just shares one
+        Uint16 id = mTextureIds.size() < 0xFFFF ? mTextureIds.size() : 0xFFFF;
+        mTextureIds[texture] = id;
+        return id;
+    }
+
+    void sortKeys()
+    {
+        size_t n = mKeys.size();
+        mScratch.resize(n);
+
+        Uint64 *src = mKeys.data();
+        Uint64 *dst = mScratch.data();
+
+        for (int shift = 0; shift < 64; shift += 8)
+        {
+            size_t count[256] = {0};
+            for (size_t i = 0; i < n; i++)
+            {
+                count[(src[i] >> shift) & 0xFF]++;
+            }
+
+            // Every key has the same byte here; this pass wouldn't move anything
+            if (count[(src[0] >> shift) & 0xFF] == n)
+            {
+                continue;
+            }
+
+            size_t offset = 0;
+            for (int b = 0; b < 256; b++)
+            {
+                size_t c = count[b];
+                count[b] = offset;
+                offset += c;
+            }
+
+            for (size_t i = 0; i < n; i++)
+            {
+                dst[count[(src[i] >> shift) & 0xFF]++] = src[i];
+            }
+
+            std::swap(src, dst);
+        }
+
+        if (src != mKeys.data())
+        {
+            mKeys.swap(mScratch);
+        }
+    }
+
+    // Draws commands [first, last) of the sorted keys, which all share a texture
+    void submit(size_t first, size_t last)
+    {
+        mStats.nBatches++;
+
+#ifdef WY_QUEUE_GEOMETRY
+        SDL_Texture *texture = mCommands[mKeys[first] & 0xFFFFFF].texture;
+        int texW = 1, texH = 1;
+        SDL_QueryTexture(texture, NULL, NULL, &texW, &texH);
+
+        int quads = last - first;
+        mVertices.resize(quads * 4);
+        while ((int)mIndices.size() < quads * 6)
+        {
+            int q = mIndices.size() / 6;
+            int quad[6] = {q * 4, q * 4 + 1, q * 4 + 2, q * 4 + 2, q * 4 + 1, q * 4 + 3};
+            mIndices.insert(mIndices.end(), quad, quad + 6);
+        }
+
+        for (int q = 0; q < quads; q++)
+        {
+            Command &cmd = mCommands[mKeys[first + q] & 0xFFFFFF];
+            float u0 = (float)cmd.src.x / texW, u1 = (float)(cmd.src.x + cmd.src.w) / texW;
+            float v0 = (float)cmd.src.y / texH, v1 = (float)(cmd.src.y + cmd.src.h) / texH;
+            float x0 = cmd.dst.x, x1 = cmd.dst.x + cmd.dst.w;
+            float y0 = cmd.dst.y, y1 = cmd.dst.y + cmd.dst.h;
+
+            SDL_Vertex *quad = mVertices.data() + q * 4;
+            quad[0] = {{x0, y0}, cmd.color, {u0, v0}};
+            quad[1] = {{x1, y0}, cmd.color, {u1, v0}};
+            quad[2] = {{x0, y1}, cmd.color, {u0, v1}};
+            quad[3] = {{x1, y1}, cmd.color, {u1, v1}};
+        }
+
+        SDL_RenderGeometry(mRenderer, texture, mVertices.data(), quads * 4, mIndices.data(), quads * 6);
+#else
+        for (size_t i = first; i < last; i++)
+        {
+            Command &cmd = mCommands[mKeys[i] & 0xFFFFFF];
+            SDL_SetTextureColorMod(cmd.texture, cmd.color.r, cmd.color.g, cmd.color.b);
+            SDL_SetTextureAlphaMod(cmd.texture, cmd.color.a);
+            SDL_RenderCopy(mRenderer, cmd.texture, &cmd.src, &cmd.dst);
+            SDL_SetTextureColorMod(cmd.texture, 0xFF, 0xFF, 0xFF);
+            SDL_SetTextureAlphaMod(cmd.texture, 0xFF);
+        }
+#endif
+    }
+
+public:
+    WY_RenderQueue(SDL_Renderer *renderer, int capacity = 1024)
+    {
+        mRenderer = renderer;
+        mCommands.reserve(capacity);
+        mKeys.reserve(capacity);
+        mScratch.reserve(capacity);
+    }
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    // Draws recorded since the last flush
+    int getCount()
+    {
+        return mCommands.size();
+    }
+
+    const WY_RenderQueueStats &getStats()
+    {
+        return mStats;
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    // Records a draw of the src rect of texture into dst, tinted by color.
+    // layer is 0-255 (drawn bottom to top), depth 0-65535 (drawn low to high
+    // among draws of one texture in one layer).
+    void draw(SDL_Texture *texture, const SDL_Rect &src, const SDL_Rect &dst, int layer = 0, int depth = 0, SDL_Color color = {0xFF, 0xFF, 0xFF, 0xFF})
+    {
+        if (texture == NULL || mCommands.size() >= 0xFFFFFF)
+        {
+            return;
+        }
+
+        Uint64 key = (Uint64)(layer & 0xFF) << 56 |
+                     (Uint64)getTextureId(texture) << 40 |
+                     (Uint64)(depth & 0xFFFF) << 24 |
+                     mCommands.size();
+
+        mKeys.push_back(key);
+        mCommands.push_back({texture, src, dst, color});
+    }
+
+    void draw(const WY_Sprite &sprite, const SDL_Rect &dst, int layer = 0, int depth = 0)
+    {
+        draw(sprite.texture, sprite.origin, dst, layer, depth);
+    }
+
+    // Sorts and draws everything recorded so far, then empties the queue.
+    // Wyngine calls this after each onRender.
+    void flush()
+    {
+        mStats = WY_RenderQueueStats();
+        mStats.nCommands = mCommands.size();
+
+        if (mCommands.empty())
+        {
+            return;
+        }
+
+        for (size_t i = 1; i < mCommands.size(); i++)
+        {
+            mStats.nSwitchesUnsorted += mCommands[i].texture != mCommands[i - 1].texture;
+        }
+
+        sortKeys();
+
+        size_t first = 0;
+        for (size_t i = 1; i <= mKeys.size(); i++)
+        {
+            if (i == mKeys.size() || mCommands[mKeys[i] & 0xFFFFFF].texture != mCommands[mKeys[first] & 0xFFFFFF].texture)
+            {
+                submit(first, i);
+                first = i;
+            }
+        }
+        mStats.nSwitchesSorted = mStats.nBatches - 1;
+
+        mCommands.clear();
+        mKeys.clear();
+    }
+
+    // Drops everything recorded since the last flush
+    void clear()
+    {
+        mCommands.clear();
+        mKeys.clear();
+    }
+
+    // Forgets texture ids, e.g. after destroying textures whose addresses may be reused
+    void resetTextures()
+    {
+        mTextureIds.clear();
+    }
+};
@@ -0,0 +1,346 @@
+// Input recording and replay
+//
+// Records everything a session's input depends on, frame by frame: the frame
+// delta, the keyboard state and the input events (keys, text, quit), plus the
+// rand() seed. Replaying the log feeds the exact same input back on the same
+// frames, so two builds can be profiled on an identical workload.
+//
+// Open the log before constructing the game, since opening it seeds rand()
+// and games usually roll their first random numbers in their constructor:
+//
+//   WY_InputLog log;
+//   log.replay("session.wyrec");
+//   Game *game = new Game();
+//   game->setInputLog(&log, true); // headless: hidden window, no frame cap
+//
+// Layout (little-endian):
+//
+//   WY_InputLogHeader
+//   per frame:
+//     Uint16 delta (ms)
+//     Uint8  mask of keyboard state words that changed, then those Uint64 words
+//     Uint16 event count, then per event a Uint32 type and its fields
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "events.h"
+
+#define WY_INPUTLOG_MAGIC SDL_FOURCC('W', 'Y', 'R', 'C')
+#define WY_INPUTLOG_VERSION 1
+
+struct WY_InputLogHeader
+{
+    Uint32 nMagic;   // WY_INPUTLOG_MAGIC, i.e. "WYRC"
+    Uint16 nVersion; // WY_INPUTLOG_VERSION
+    Uint16 nWords;   // keyboard state words per frame
+    Uint32 nSeed;    // passed to srand()
+};
+
+class WY_InputLog
+{
+    enum Mode
+    {
+        LOG_NONE,
+        LOG_RECORD,
+        LOG_REPLAY
+    };
+
+    Mode mMode = LOG_NONE;
+    std::ofstream ofs;
+    std::ifstream ifs;
+    Uint64 mKeys[SDL_NUM_SCANCODES / 64]; // last frame's keyboard state
+    int nFrames = 0;
+    bool bFinished = false;
+
+    template <class T>
+    void write(T value)
+    {
+        ofs.write((const char *)&value, sizeof(T));
+    }
+
+    template <class T>
+    bool read(T &value)
+    {
+        return (bool)ifs.read((char *)&value, sizeof(T));
+    }
+
+    void writeString(const char *text)
+    {
+        Uint8 len = (Uint8)strnlen(text, 255);
+        write(len);
+        ofs.write(text, len);
+    }
+
+    // Reads into a fixed-size SDL text field, always null-terminated
+    bool readString(char *text, size_t size)
+    {
+        Uint8 len;
+        if (!read(len) || len >= size)
+        {
+            return false;
+        }
+
+        text[len] = '\0';
+        return (bool)ifs.read(text, len);
+    }
+
+    void writeEvent(const SDL_Event &event)
+    {
+        write(event.type);
+
+        switch (event.type)
+        {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            write(event.key.keysym.sym);
+            write((Uint16)event.key.keysym.scancode);
+            write(event.key.keysym.mod);
+            write(event.key.repeat);
+            break;
+
+        case SDL_TEXTINPUT:
+            writeString(event.text.text);
+            break;
+
+        case SDL_TEXTEDITING:
+            writeString(event.edit.text);
+            write(event.edit.start);
+            write(event.edit.length);
+            break;
+        }
+    }
+
+    bool readEvent(SDL_Event &event)
+    {
+        memset(&event, 0, sizeof(SDL_Event));
+        if (!read(event.type))
+        {
+            return false;
+        }
+
+        switch (event.type)
+        {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+        {
+            Uint16 scancode;
+            bool bOk = read(event.key.keysym.sym) && read(scancode) && read(event.key.keysym.mod) && read(event.key.repeat);
+            event.key.keysym.scancode = (SDL_Scancode)scancode;
+            event.key.state = event.type == SDL_KEYDOWN ? SDL_PRESSED : SDL_RELEASED;
+            return bOk;
+        }
+
+        case SDL_TEXTINPUT:
+            return readString(event.text.text, sizeof(event.text.text));
+
+        case SDL_TEXTEDITING:
+            return readString(event.edit.text, sizeof(event.edit.text)) && read(event.edit.start) && read(event.edit.length);
+        }
+
+        return true;
+    }
+
+    static bool isInputEvent(Uint32 type)
+    {
+        return type == SDL_KEYDOWN || type == SDL_KEYUP || type == SDL_TEXTINPUT || type == SDL_TEXTEDITING || type == SDL_QUIT;
+    }
+
+public:
+    ~WY_InputLog()
+    {
+        close();
+    }
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    bool isRecording()
+    {
+        return mMode == LOG_RECORD;
+    }
+
+    bool isReplaying()
+    {
+        return mMode == LOG_REPLAY;
+    }
+
+    // The replay ran out of frames
+    bool isFinished()
+    {
+        return bFinished;
+    }
+
+    // Frames recorded or replayed so far
+    int getFrameCount()
+    {
+        return nFrames;
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    // Starts a new log and seeds rand() with a fresh seed that it saves
+    bool record(const std::string &file)
+    {
+        close();
+
+        ofs.open(file, std::ios::binary);
+        if (!ofs.is_open())
+        {
+            SDL_Log("Unable to create input log %s!\n", file.c_str());
+            return false;
+        }
+
+        WY_InputLogHeader header = {WY_INPUTLOG_MAGIC, WY_INPUTLOG_VERSION, SDL_NUM_SCANCODES / 64, (Uint32)SDL_GetPerformanceCounter()};
+        write(header);
+        srand(header.nSeed);
+
+        memset(mKeys, 0, sizeof(mKeys));
+        mMode = LOG_RECORD;
+        return true;
+    }
+
+    // Opens a log for replay and seeds rand() the way the recording did
+    bool replay(const std::string &file)
+    {
+        close();
+
+        ifs.open(file, std::ios::binary);
+        if (!ifs.is_open())
+        {
+            SDL_Log("Unable to open input log %s!\n", file.c_str());
+            return false;
+        }
+
+        WY_InputLogHeader header;
+        if (!read(header) || header.nMagic != WY_INPUTLOG_MAGIC || header.nVersion != WY_INPUTLOG_VERSION || header.nWords != SDL_NUM_SCANCODES / 64)
+        {
+            SDL_Log("Invalid input log %s!\n", file.c_str());
+            ifs.close();
+            return false;
+        }
+        srand(header.nSeed);
+
+        memset(mKeys, 0, sizeof(mKeys));
+        mMode = LOG_REPLAY;
+        return true;
+    }
+
+    void close()
+    {
+        if (ofs.is_open())
+        {
+            ofs.close();
+        }
+        if (ifs.is_open())
+        {
+            ifs.close();
+        }
+
+        mMode = LOG_NONE;
+        nFrames = 0;
+        bFinished = false;
+    }
+
+    // Appends one frame. keys is the keyboard state the frame saw.
+    void writeFrame(int deltaMs, const Uint64 *keys, const WY_EventBuffer &events)
+    {
+        if (mMode != LOG_RECORD)
+        {
+            return;
+        }
+
+        write((Uint16)std::min(std::max(deltaMs, 0), 0xFFFF));
+
+        // Only the state words that changed; usually none
+        Uint8 changed = 0;
+        for (int w = 0; w < SDL_NUM_SCANCODES / 64; w++)
+        {
+            changed |= (keys[w] != mKeys[w]) << w;
+        }
+        write(changed);
+        for (int w = 0; w < SDL_NUM_SCANCODES / 64; w++)
+        {
+            if (changed & (1 << w))
+            {
+                write(keys[w]);
+                mKeys[w] = keys[w];
+            }
+        }
+
+        Uint16 count = 0;
+        for (const SDL_Event &event : events)
+        {
+            count += isInputEvent(event.type);
+        }
+        write(count);
+        for (const SDL_Event &event : events)
+        {
+            if (isInputEvent(event.type))
+            {
+                writeEvent(event);
+            }
+        }
+
+        nFrames++;
+    }
+
+    // Reads the next frame into deltaMs, keys and events (replacing their
+    // contents). Returns false when the log has no more frames.
+    bool readFrame(int &deltaMs, Uint64 *keys, WY_EventBuffer &events)
+    {
+        if (mMode != LOG_REPLAY || bFinished)
+        {
+            return false;
+        }
+
+        Uint16 delta;
+        Uint8 changed;
+        if (!read(delta) || !read(changed))
+        {
+            bFinished = true;
+            return false;
+        }
+
+        for (int w = 0; w < SDL_NUM_SCANCODES / 64; w++)
+        {
+            if ((changed & (1 << w)) && !read(mKeys[w]))
+            {
+                bFinished = true;
+                return false;
+            }
+        }
+
+        Uint16 count;
+        if (!read(count))
+        {
+            bFinished = true;
+            return false;
+        }
+
+        events.clear();
+        for (int i = 0; i < count; i++)
+        {
+            SDL_Event event;
+            if (!readEvent(event))
+            {
+                bFinished = true;
+                return false;
+            }
+            events.push(event);
+        }
+
+        deltaMs = delta;
+        memcpy(keys, mKeys, sizeof(mKeys));
+        nFrames++;
+        return true;
+    }
+};
@@ -0,0 +1,249 @@
+// Spatial hash
+//
+// Buckets rects (e.g. sprite bounds) by the grid cells they overlap, so a
+// query only looks at the items near the queried area instead of every item
+// in the world. Cells are hashed into a fixed bucket table, so the world has
+// no bounds and memory doesn't grow with its size.
+//
+// Items are identified by the int returned from insert(). Moving an item
+// within the same cells only updates its rect.
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <vector>
+
+struct WY_SpatialStats
+{
+    int nCellsVisited = 0; // cells looked at by the last query
+    int nItemsVisited = 0; // items tested against the last query's area
+    int nItemsFound = 0;   // items that overlapped it
+};
+
+class WY_SpatialHash
+{
+    struct Item
+    {
+        SDL_Rect rect;
+        int cx0, cy0, cx1, cy1; // cells it is linked into
+        Uint32 nStamp = 0;      // last query that saw it
+        bool bUsed = false;
+    };
+
+    int mCellSize;
+    int mMask;
+    std::vector<std::vector<int>> mBuckets;
+    std::vector<Item> mItems;
+    std::vector<int> mFree;
+    int nCount = 0;
+    Uint32 nStamp = 0;
+    WY_SpatialStats mStats;
+
+    // Rounds towards negative infinity, so cell -1 is left of 0
+    int cellOf(int v)
+    {
+        return v >= 0 ? v / mCellSize : (v + 1) / mCellSize - 1;
+    }
+
+    std::vector<int> &getBucket(int cx, int cy)
+    {
+        Uint32 hash = (Uint32)cx * 73856093u ^ (Uint32)cy * 19349663u;
+        return mBuckets[hash & mMask];
+    }
+
+    void link(int id)
+    {
+        Item &item = mItems[id];
+        for (int cy = item.cy0; cy <= item.cy1; cy++)
+        {
+            for (int cx = item.cx0; cx <= item.cx1; cx++)
+            {
+                getBucket(cx, cy).push_back(id);
+            }
+        }
+    }
+
+    void unlink(int id)
+    {
+        Item &item = mItems[id];
+        for (int cy = item.cy0; cy <= item.cy1; cy++)
+        {
+            for (int cx = item.cx0; cx <= item.cx1; cx++)
+            {
+                // Order within a bucket doesn't matter, so swap-remove
+                std::vector<int> &bucket = getBucket(cx, cy);
+                auto found = std::find(bucket.begin(), bucket.end(), id);
+                if (found != bucket.end())
+                {
+                    *found = bucket.back();
+                    bucket.pop_back();
+                }
+            }
+        }
+    }
+
+    void setCells(Item &item, const SDL_Rect &rect)
+    {
+        item.rect = rect;
+        item.cx0 = cellOf(rect.x);
+        item.cy0 = cellOf(rect.y);
+        item.cx1 = cellOf(rect.x + std::max(rect.w, 1) - 1);
+        item.cy1 = cellOf(rect.y + std::max(rect.h, 1) - 1);
+    }
+
+public:
+    // cellSize should be around the size of a typical item. buckets (rounded
+    // up to a power of two) should be about the number of occupied cells;
+    // fewer makes cells share buckets and queries test unrelated items.
+    WY_SpatialHash(int cellSize = 64, int buckets = 4096)
+    {
+        mCellSize = std::max(cellSize, 1);
+
+        int size = 1;
+        while (size < buckets)
+        {
+            size *= 2;
+        }
+        mMask = size - 1;
+        mBuckets.resize(size);
+    }
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    int getCount()
+    {
+        return nCount;
+    }
+
+    SDL_Rect getRect(int id)
+    {
+        return mItems[id].rect;
+    }
+
+    const WY_SpatialStats &getStats()
+    {
+        return mStats;
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    // Returns the new item's id. Ids of removed items are reused.
+    int insert(const SDL_Rect &rect)
+    {
+        int id;
+        if (!mFree.empty())
+        {
+            id = mFree.back();
+            mFree.pop_back();
+        }
+        else
+        {
+            id = mItems.size();
+            mItems.push_back(Item());
+        }
+
+        Item &item = mItems[id];
+        item.bUsed = true;
+        setCells(item, rect);
+        link(id);
+
+        nCount++;
+        return id;
+    }
+
+    void move(int id, const SDL_Rect &rect)
+    {
+        Item &item = mItems[id];
+        Item moved = item;
+        setCells(moved, rect);
+
+        if (moved.cx0 != item.cx0 || moved.cy0 != item.cy0 || moved.cx1 != item.cx1 || moved.cy1 != item.cy1)
+        {
+            unlink(id);
+            item = moved;
+            link(id);
+            return;
+        }
+
+        item.rect = rect;
+    }
+
+    void remove(int id)
+    {
+        if (id < 0 || id >= (int)mItems.size() || !mItems[id].bUsed)
+        {
+            return;
+        }
+
+        unlink(id);
+        mItems[id].bUsed = false;
+        mFree.push_back(id);
+        nCount--;
+    }
+
+    void clear()
+    {
+        for (auto &bucket : mBuckets)
+        {
+            bucket.clear();
+        }
+        mItems.clear();
+        mFree.clear();
+        nCount = 0;
+    }
+
+    // Fills out with the ids of all items overlapping area (each once, in no
+    // particular order) and returns how many there are
+    int query(const SDL_Rect &area, std::vector<int> &out)
+    {
+        out.clear();
+        mStats = WY_SpatialStats();
+
+        if (++nStamp == 0)
+        {
+            // Stamps wrapped around; forget the old ones
+            for (auto &item : mItems)
+            {
+                item.nStamp = 0;
+            }
+            nStamp = 1;
+        }
+
+        int cx0 = cellOf(area.x), cx1 = cellOf(area.x + std::max(area.w, 1) - 1);
+        int cy0 = cellOf(area.y), cy1 = cellOf(area.y + std::max(area.h, 1) - 1);
+
+        for (int cy = cy0; cy <= cy1; cy++)
+        {
+            for (int cx = cx0; cx <= cx1; cx++)
+            {
+                mStats.nCellsVisited++;
+
+                for (int id : getBucket(cx, cy))
+                {
+                    Item &item = mItems[id];
+                    if (item.nStamp == nStamp)
+                    {
+                        continue; // spans several cells, already tested
+                    }
+
+                    item.nStamp = nStamp;
+                    mStats.nItemsVisited++;
+
+                    // Buckets hold other cells' items too, so always test the rect
+                    if (SDL_HasIntersection(&item.rect, &area))
+                    {
+                        out.push_back(id);
+                    }
+                }
+            }
+        }
+
+        mStats.nItemsFound = out.size();
+        return mStats.nItemsFound;
+    }
+};
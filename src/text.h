@@ -0,0 +1,402 @@
+// Editable text
+//
+// A gap buffer: the text lives in one array with a gap at the edit position,
+// so typing, deleting and moving the cursor around one spot only touch a few
+// bytes however long the text is. Moving the edit position moves the gap
+// (copying only the text in between).
+//
+// getSpans() returns the text as the two runs either side of the gap, as
+// std::string_views, without moving anything; use it for per-frame display.
+// getText() returns one contiguous view, which needs the gap moved to the end
+// first: free while typing at the end, but after an edit in the middle it
+// copies the text after the edit, and the next edit there copies it back.
+// Views are valid until the next edit. getVersion() goes up with every edit,
+// so callers can skip re-reading text that hasn't changed.
+//
+// Positions are byte offsets into the UTF-8 text and are kept on code point
+// boundaries: moving and deleting go one code point at a time.
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Text as up to two pieces, in order
+struct WY_TextSpans
+{
+    std::string_view first;
+    std::string_view second;
+
+    size_t size() const
+    {
+        return first.size() + second.size();
+    }
+};
+
+class WY_TextBuffer
+{
+    std::vector<char> mBuffer; // text before the gap, the gap, text after the gap
+    size_t nGapStart = 0;
+    size_t nGapEnd = 0;
+
+    size_t nCursor = 0;
+    size_t nAnchor = 0; // other end of the selection; equal to nCursor when nothing is selected
+    Uint64 nVersion = 0;
+
+    // IME composition in progress, shown at the cursor but not part of the text yet
+    std::string mComposition;
+    int nCompositionCursor = 0;
+    int nCompositionLength = 0;
+
+    size_t gapSize() const
+    {
+        return nGapEnd - nGapStart;
+    }
+
+    char at(size_t pos) const
+    {
+        return pos < nGapStart ? mBuffer[pos] : mBuffer[pos + gapSize()];
+    }
+
+    static bool isContinuation(char c)
+    {
+        return (c & 0xC0) == 0x80;
+    }
+
+    void moveGap(size_t pos)
+    {
+        char *data = mBuffer.data();
+
+        if (pos < nGapStart)
+        {
+            size_t n = nGapStart - pos;
+            memmove(data + nGapEnd - n, data + pos, n);
+            nGapStart -= n;
+            nGapEnd -= n;
+        }
+        else if (pos > nGapStart)
+        {
+            size_t n = pos - nGapStart;
+            memmove(data + nGapStart, data + nGapEnd, n);
+            nGapStart += n;
+            nGapEnd += n;
+        }
+    }
+
+    void reserveGap(size_t n)
+    {
+        if (gapSize() >= n)
+        {
+            return;
+        }
+
+        size_t after = mBuffer.size() - nGapEnd;
+        size_t size = std::max(mBuffer.size() * 2, length() + n + 64);
+        mBuffer.resize(size);
+
+        char *data = mBuffer.data();
+        memmove(data + size - after, data + nGapEnd, after);
+        nGapEnd = size - after;
+    }
+
+    size_t prevBoundary(size_t pos) const
+    {
+        while (pos > 0)
+        {
+            pos--;
+            if (!isContinuation(at(pos)))
+            {
+                break;
+            }
+        }
+
+        return pos;
+    }
+
+    size_t nextBoundary(size_t pos) const
+    {
+        size_t len = length();
+        if (pos < len)
+        {
+            pos++;
+        }
+        while (pos < len && isContinuation(at(pos)))
+        {
+            pos++;
+        }
+
+        return pos;
+    }
+
+    size_t lineStart(size_t pos) const
+    {
+        while (pos > 0 && at(pos - 1) != '\n')
+        {
+            pos--;
+        }
+
+        return pos;
+    }
+
+    size_t lineEnd(size_t pos) const
+    {
+        size_t len = length();
+        while (pos < len && at(pos) != '\n')
+        {
+            pos++;
+        }
+
+        return pos;
+    }
+
+    void erase(size_t start, size_t end)
+    {
+        moveGap(start);
+        nGapEnd += end - start;
+        nCursor = nAnchor = start;
+        nVersion++;
+    }
+
+    void moveTo(size_t pos, bool bSelect)
+    {
+        nCursor = pos;
+        if (!bSelect)
+        {
+            nAnchor = pos;
+        }
+    }
+
+public:
+    WY_TextBuffer(size_t capacity = 256)
+    {
+        mBuffer.resize(capacity);
+        nGapEnd = capacity;
+    }
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    // Length in bytes
+    size_t length() const
+    {
+        return mBuffer.size() - gapSize();
+    }
+
+    bool empty() const
+    {
+        return length() == 0;
+    }
+
+    // The whole text as one view; valid until the next edit. Moves the gap,
+    // see getSpans() for a snapshot that never copies.
+    std::string_view getText()
+    {
+        moveGap(length());
+        return std::string_view(mBuffer.data(), length());
+    }
+
+    // Bytes [start, end) of the text, without moving the gap; valid until the next edit
+    WY_TextSpans getSpans(size_t start, size_t end) const
+    {
+        end = std::min(end, length());
+        start = std::min(start, end);
+
+        const char *data = mBuffer.data();
+        if (end <= nGapStart)
+        {
+            return {std::string_view(data + start, end - start), {}};
+        }
+        if (start >= nGapStart)
+        {
+            return {std::string_view(data + start + gapSize(), end - start), {}};
+        }
+
+        return {std::string_view(data + start, nGapStart - start), std::string_view(data + nGapEnd, end - nGapStart)};
+    }
+
+    WY_TextSpans getSpans() const
+    {
+        return getSpans(0, length());
+    }
+
+    // Goes up by one with every edit
+    Uint64 getVersion() const
+    {
+        return nVersion;
+    }
+
+    size_t getCursor() const
+    {
+        return nCursor;
+    }
+
+    bool hasSelection() const
+    {
+        return nAnchor != nCursor;
+    }
+
+    size_t getSelectionStart() const
+    {
+        return std::min(nAnchor, nCursor);
+    }
+
+    size_t getSelectionLength() const
+    {
+        return std::max(nAnchor, nCursor) - getSelectionStart();
+    }
+
+    // The selected text; valid until the next edit
+    std::string_view getSelectedText()
+    {
+        return getText().substr(getSelectionStart(), getSelectionLength());
+    }
+
+    std::string_view getComposition() const
+    {
+        return mComposition;
+    }
+
+    // Cursor and selection within the composition, in characters (as SDL reports them)
+    int getCompositionCursor() const
+    {
+        return nCompositionCursor;
+    }
+
+    int getCompositionLength() const
+    {
+        return nCompositionLength;
+    }
+
+    bool isComposing() const
+    {
+        return !mComposition.empty();
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    // Types text at the cursor, replacing the selection
+    void insert(std::string_view text)
+    {
+        if (hasSelection())
+        {
+            erase(getSelectionStart(), getSelectionStart() + getSelectionLength());
+        }
+
+        if (text.empty())
+        {
+            return;
+        }
+
+        moveGap(nCursor);
+        reserveGap(text.size());
+        memcpy(mBuffer.data() + nGapStart, text.data(), text.size());
+        nGapStart += text.size();
+
+        nCursor = nAnchor = nCursor + text.size();
+        nVersion++;
+    }
+
+    // Backspace: deletes the selection, or the code point before the cursor
+    void deleteBackward()
+    {
+        if (hasSelection())
+        {
+            erase(getSelectionStart(), getSelectionStart() + getSelectionLength());
+        }
+        else if (nCursor > 0)
+        {
+            erase(prevBoundary(nCursor), nCursor);
+        }
+    }
+
+    // Delete: deletes the selection, or the code point after the cursor
+    void deleteForward()
+    {
+        if (hasSelection())
+        {
+            erase(getSelectionStart(), getSelectionStart() + getSelectionLength());
+        }
+        else if (nCursor < length())
+        {
+            erase(nCursor, nextBoundary(nCursor));
+        }
+    }
+
+    // The move functions extend the selection when bSelect is set, and
+    // otherwise drop it.
+
+    void moveLeft(bool bSelect = false)
+    {
+        if (hasSelection() && !bSelect)
+        {
+            moveTo(getSelectionStart(), false);
+            return;
+        }
+
+        moveTo(prevBoundary(nCursor), bSelect);
+    }
+
+    void moveRight(bool bSelect = false)
+    {
+        if (hasSelection() && !bSelect)
+        {
+            moveTo(getSelectionStart() + getSelectionLength(), false);
+            return;
+        }
+
+        moveTo(nextBoundary(nCursor), bSelect);
+    }
+
+    void moveHome(bool bSelect = false)
+    {
+        moveTo(lineStart(nCursor), bSelect);
+    }
+
+    void moveEnd(bool bSelect = false)
+    {
+        moveTo(lineEnd(nCursor), bSelect);
+    }
+
+    // Moves to a byte offset, snapped back to a code point boundary
+    void setCursor(size_t pos, bool bSelect = false)
+    {
+        pos = std::min(pos, length());
+        while (pos > 0 && pos < length() && isContinuation(at(pos)))
+        {
+            pos--;
+        }
+
+        moveTo(pos, bSelect);
+    }
+
+    void selectAll()
+    {
+        nAnchor = 0;
+        nCursor = length();
+    }
+
+    // Updates the IME composition; an empty text ends it
+    void setComposition(std::string_view text, int cursor, int selectionLength)
+    {
+        mComposition = text;
+        nCompositionCursor = cursor;
+        nCompositionLength = selectionLength;
+        nVersion++;
+    }
+
+    void clear()
+    {
+        nGapStart = 0;
+        nGapEnd = mBuffer.size();
+        nCursor = nAnchor = 0;
+        mComposition.clear();
+        nVersion++;
+    }
+};
@@ -0,0 +1,437 @@
+// Tilemap
+//
+// Stores tile indices in square chunks (32x32 tiles by default). Each chunk is
+// baked once into its own texture and then drawn with a single copy, and only
+// the chunks overlapping the camera are visited, so drawing costs the same
+// for a 1000x1000 map as for a screenful.
+//
+// Baked chunks are kept up to a budget and the least recently drawn ones are
+// released first, so a large map never holds a texture per chunk. Baked
+// chunks are kept in an LRU list, so finding the one to release is O(1).
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <vector>
+
+#include "image.h"
+#include "framebuffer.h"
+#include "camera.h"
+
+#define WY_TILE_EMPTY 0xFFFF
+
+struct WY_TilemapStats
+{
+    int nChunksVisited = 0; // chunks overlapping the camera in the last draw
+    int nChunksDrawn = 0;   // of those, the ones that had tiles
+    int nChunksBaked = 0;   // baked in the last draw
+    int nTexturesResident = 0;
+};
+
+class WY_Tilemap
+{
+    struct Chunk
+    {
+        std::vector<Uint16> tiles;
+        int nTileCount = 0; // non-empty tiles
+        SDL_Texture *texture = nullptr;
+        bool bDirty = true;
+        Uint32 nLastDrawn = 0;
+        int nPrev = -1; // LRU neighbours (chunk indices), while baked
+        int nNext = -1;
+    };
+
+    int mMapW, mMapH;   // in tiles
+    int mTileSize;      // in pixels, tiles are square
+    int mChunkSize;     // in tiles
+    int mChunksW, mChunksH;
+    std::vector<Chunk> mChunks;
+
+    WY_Sprite mTileset; // texture and the region of it holding the tiles
+    int mTilesetCols;
+
+    int mMaxTextures;
+    int nTexturesResident = 0;
+    int nLruHead = -1; // most recently drawn baked chunk
+    int nLruTail = -1; // least recently drawn
+    Uint32 nDrawCount = 0;
+    WY_TilemapStats mStats;
+
+    Chunk &getChunk(int cx, int cy)
+    {
+        return mChunks[cy * mChunksW + cx];
+    }
+
+    SDL_Rect getTileRect(Uint16 tile)
+    {
+        return {
+            mTileset.origin.x + (tile % mTilesetCols) * mTileSize,
+            mTileset.origin.y + (tile / mTilesetCols) * mTileSize,
+            mTileSize,
+            mTileSize};
+    }
+
+    void unlink(int index)
+    {
+        Chunk &chunk = mChunks[index];
+        (chunk.nPrev >= 0 ? mChunks[chunk.nPrev].nNext : nLruHead) = chunk.nNext;
+        (chunk.nNext >= 0 ? mChunks[chunk.nNext].nPrev : nLruTail) = chunk.nPrev;
+        chunk.nPrev = chunk.nNext = -1;
+    }
+
+    void pushFront(int index)
+    {
+        Chunk &chunk = mChunks[index];
+        chunk.nPrev = -1;
+        chunk.nNext = nLruHead;
+        (nLruHead >= 0 ? mChunks[nLruHead].nPrev : nLruTail) = index;
+        nLruHead = index;
+    }
+
+    // Moves a baked chunk to the front of the LRU list
+    void touch(int index)
+    {
+        if (mChunks[index].texture != nullptr && nLruHead != index)
+        {
+            unlink(index);
+            pushFront(index);
+        }
+    }
+
+    void releaseTexture(int index)
+    {
+        Chunk &chunk = mChunks[index];
+        if (chunk.texture != nullptr)
+        {
+            unlink(index);
+            SDL_DestroyTexture(chunk.texture);
+            chunk.texture = nullptr;
+            chunk.bDirty = true;
+            nTexturesResident--;
+        }
+    }
+
+    // Frees the least recently drawn baked chunk, unless it is in the current view
+    void evictOne()
+    {
+        if (nLruTail >= 0 && mChunks[nLruTail].nLastDrawn != nDrawCount)
+        {
+            releaseTexture(nLruTail);
+        }
+    }
+
+    void bake(SDL_Renderer *renderer, int index)
+    {
+        Chunk &chunk = mChunks[index];
+        int size = mChunkSize * mTileSize;
+
+        if (chunk.texture == nullptr)
+        {
+            if (nTexturesResident >= mMaxTextures)
+            {
+                evictOne();
+            }
+
+            chunk.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, size, size);
+            if (chunk.texture == nullptr)
+            {
+                SDL_Log("Unable to create tilemap chunk texture! SDL Error: %s\n", SDL_GetError());
+                return;
+            }
+            SDL_SetTextureBlendMode(chunk.texture, SDL_BLENDMODE_BLEND);
+            nTexturesResident++;
+            pushFront(index);
+        }
+
+        // Render into the chunk, then go back to whatever target, draw color,
+        // viewport and clip were set (e.g. Wyngine's dirty-rect clip).
+        // Changing the target resets the viewport and clip.
+        SDL_Texture *target = SDL_GetRenderTarget(renderer);
+        Uint8 r, g, b, a;
+        SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+        SDL_Rect viewport, clip;
+        SDL_RenderGetViewport(renderer, &viewport);
+        SDL_RenderGetClipRect(renderer, &clip);
+        bool bClipped = SDL_RenderIsClipEnabled(renderer);
+
+        SDL_SetRenderTarget(renderer, chunk.texture);
+        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0x00);
+        SDL_RenderClear(renderer);
+
+        for (int y = 0; y < mChunkSize; y++)
+        {
+            for (int x = 0; x < mChunkSize; x++)
+            {
+                Uint16 tile = chunk.tiles[y * mChunkSize + x];
+                if (tile == WY_TILE_EMPTY)
+                {
+                    continue;
+                }
+
+                SDL_Rect src = getTileRect(tile);
+                SDL_Rect dst = {x * mTileSize, y * mTileSize, mTileSize, mTileSize};
+                SDL_RenderCopy(renderer, mTileset.texture, &src, &dst);
+            }
+        }
+
+        SDL_SetRenderTarget(renderer, target);
+        SDL_RenderSetViewport(renderer, &viewport);
+        SDL_RenderSetClipRect(renderer, bClipped ? &clip : NULL);
+        SDL_SetRenderDrawColor(renderer, r, g, b, a);
+
+        chunk.bDirty = false;
+        mStats.nChunksBaked++;
+    }
+
+    // Chunk range overlapping camera (in world pixels), clamped to the map
+    bool getVisibleChunks(const SDL_Rect &camera, int &cx0, int &cy0, int &cx1, int &cy1)
+    {
+        int chunkPixels = mChunkSize * mTileSize;
+
+        int right = std::min(camera.x + camera.w, mMapW * mTileSize);
+        int bottom = std::min(camera.y + camera.h, mMapH * mTileSize);
+        if (right <= std::max(camera.x, 0) || bottom <= std::max(camera.y, 0))
+        {
+            return false;
+        }
+
+        cx0 = std::max(0, camera.x / chunkPixels);
+        cy0 = std::max(0, camera.y / chunkPixels);
+        cx1 = (right - 1) / chunkPixels;
+        cy1 = (bottom - 1) / chunkPixels;
+
+        return true;
+    }
+
+    // Draws the chunks overlapping view. With a camera, chunks are placed and
+    // scaled by it; otherwise view's top-left corner goes to screenX, screenY.
+    void drawChunks(SDL_Renderer *renderer, const SDL_Rect &view, WY_Camera *camera, int screenX, int screenY)
+    {
+        nDrawCount++;
+        mStats.nChunksVisited = 0;
+        mStats.nChunksDrawn = 0;
+        mStats.nChunksBaked = 0;
+
+        int cx0, cy0, cx1, cy1;
+        if (!getVisibleChunks(view, cx0, cy0, cx1, cy1))
+        {
+            return;
+        }
+
+        int chunkPixels = mChunkSize * mTileSize;
+
+        // Mark the whole view as in use first, so baking one of its chunks
+        // never evicts another: they all move ahead of any chunk off screen
+        for (int cy = cy0; cy <= cy1; cy++)
+        {
+            for (int cx = cx0; cx <= cx1; cx++)
+            {
+                getChunk(cx, cy).nLastDrawn = nDrawCount;
+                touch(cy * mChunksW + cx);
+            }
+        }
+
+        for (int cy = cy0; cy <= cy1; cy++)
+        {
+            for (int cx = cx0; cx <= cx1; cx++)
+            {
+                Chunk &chunk = getChunk(cx, cy);
+                mStats.nChunksVisited++;
+
+                if (chunk.nTileCount == 0)
+                {
+                    continue;
+                }
+
+                if (chunk.bDirty || chunk.texture == nullptr)
+                {
+                    bake(renderer, cy * mChunksW + cx);
+                    if (chunk.texture == nullptr)
+                    {
+                        continue;
+                    }
+                }
+
+                SDL_Rect world = {cx * chunkPixels, cy * chunkPixels, chunkPixels, chunkPixels};
+                SDL_Rect dst = camera != nullptr
+                                   ? camera->toScreen(world)
+                                   : SDL_Rect{screenX + world.x - view.x, screenY + world.y - view.y, chunkPixels, chunkPixels};
+                SDL_RenderCopy(renderer, chunk.texture, NULL, &dst);
+                mStats.nChunksDrawn++;
+            }
+        }
+
+        mStats.nTexturesResident = nTexturesResident;
+    }
+
+public:
+    // mapW x mapH tiles of tileSize pixels, drawn from the tiles laid out
+    // row-major in tileset.origin (e.g. a sprite from WY_Atlas)
+    WY_Tilemap(int mapW, int mapH, int tileSize, WY_Sprite tileset, int chunkSize = 32, int maxTextures = 64)
+    {
+        mMapW = mapW;
+        mMapH = mapH;
+        mTileSize = tileSize;
+        mChunkSize = chunkSize;
+        mChunksW = (mapW + chunkSize - 1) / chunkSize;
+        mChunksH = (mapH + chunkSize - 1) / chunkSize;
+        mMaxTextures = std::max(maxTextures, 1);
+
+        mTileset = tileset;
+        if (mTileset.origin.w == 0 && mTileset.texture != nullptr)
+        {
+            SDL_QueryTexture(mTileset.texture, NULL, NULL, &mTileset.origin.w, &mTileset.origin.h);
+        }
+        mTilesetCols = std::max(mTileset.origin.w / tileSize, 1);
+
+        mChunks.resize(mChunksW * mChunksH);
+        for (auto &chunk : mChunks)
+        {
+            chunk.tiles.assign(chunkSize * chunkSize, WY_TILE_EMPTY);
+        }
+    }
+
+    ~WY_Tilemap()
+    {
+        invalidate();
+    }
+
+    // ==================================================
+    // Getters
+    // ==================================================
+
+    int getW()
+    {
+        return mMapW;
+    }
+
+    int getH()
+    {
+        return mMapH;
+    }
+
+    int getTileSize()
+    {
+        return mTileSize;
+    }
+
+    Uint16 getTile(int x, int y)
+    {
+        if (x < 0 || y < 0 || x >= mMapW || y >= mMapH)
+        {
+            return WY_TILE_EMPTY;
+        }
+
+        return getChunk(x / mChunkSize, y / mChunkSize).tiles[(y % mChunkSize) * mChunkSize + x % mChunkSize];
+    }
+
+    const WY_TilemapStats &getStats()
+    {
+        return mStats;
+    }
+
+    // ==================================================
+    // Setters
+    // ==================================================
+
+    // Marks the tile's chunk for re-baking if the tile changed
+    void setTile(int x, int y, Uint16 tile)
+    {
+        if (x < 0 || y < 0 || x >= mMapW || y >= mMapH)
+        {
+            return;
+        }
+
+        Chunk &chunk = getChunk(x / mChunkSize, y / mChunkSize);
+        Uint16 &slot = chunk.tiles[(y % mChunkSize) * mChunkSize + x % mChunkSize];
+        if (slot == tile)
+        {
+            return;
+        }
+
+        chunk.nTileCount += (tile != WY_TILE_EMPTY) - (slot != WY_TILE_EMPTY);
+        slot = tile;
+        chunk.bDirty = true;
+    }
+
+    // ==================================================
+    // Methods
+    // ==================================================
+
+    // Draws the part of the map inside camera (world pixels) with the camera's
+    // top-left corner at screenX, screenY
+    void draw(SDL_Renderer *renderer, const SDL_Rect &camera, int screenX = 0, int screenY = 0)
+    {
+        drawChunks(renderer, camera, nullptr, screenX, screenY);
+    }
+
+    // Draws what camera sees, at its zoom
+    void draw(SDL_Renderer *renderer, WY_Camera *camera)
+    {
+        drawChunks(renderer, camera->getView(), camera, 0, 0);
+    }
+
+    // Software renderer version: blits the visible tiles straight from the
+    // tileset bitmap (laid out like the tileset sprite's region)
+    void draw(WY_Framebuffer *framebuffer, const WY_Bitmap &tileset, const SDL_Rect &camera, int screenX = 0, int screenY = 0)
+    {
+        mStats.nChunksVisited = 0;
+        mStats.nChunksDrawn = 0;
+        mStats.nChunksBaked = 0;
+
+        int cx0, cy0, cx1, cy1;
+        if (!getVisibleChunks(camera, cx0, cy0, cx1, cy1))
+        {
+            return;
+        }
+
+        // Visible tile range
+        int tx0 = std::max(0, camera.x / mTileSize);
+        int ty0 = std::max(0, camera.y / mTileSize);
+        int tx1 = std::min(mMapW - 1, (camera.x + camera.w - 1) / mTileSize);
+        int ty1 = std::min(mMapH - 1, (camera.y + camera.h - 1) / mTileSize);
+
+        for (int cy = cy0; cy <= cy1; cy++)
+        {
+            for (int cx = cx0; cx <= cx1; cx++)
+            {
+                Chunk &chunk = getChunk(cx, cy);
+                mStats.nChunksVisited++;
+
+                if (chunk.nTileCount == 0)
+                {
+                    continue;
+                }
+
+                int x0 = std::max(tx0, cx * mChunkSize), x1 = std::min(tx1, cx * mChunkSize + mChunkSize - 1);
+                int y0 = std::max(ty0, cy * mChunkSize), y1 = std::min(ty1, cy * mChunkSize + mChunkSize - 1);
+
+                for (int y = y0; y <= y1; y++)
+                {
+                    const Uint16 *row = chunk.tiles.data() + (y % mChunkSize) * mChunkSize;
+                    for (int x = x0; x <= x1; x++)
+                    {
+                        Uint16 tile = row[x % mChunkSize];
+                        if (tile != WY_TILE_EMPTY)
+                        {
+                            framebuffer->blit(tileset, getTileRect(tile), screenX + x * mTileSize - camera.x, screenY + y * mTileSize - camera.y);
+                        }
+                    }
+                }
+
+                mStats.nChunksDrawn++;
+            }
+        }
+    }
+
+    // Releases all baked chunks; they are re-baked when next drawn.
+    // Call after SDL_RENDER_TARGETS_RESET, or to free memory.
+    void invalidate()
+    {
+        while (nLruTail >= 0)
+        {
+            releaseTexture(nLruTail);
+        }
+    }
+};
@@ -75,15 +75,27 @@ public:
         dTime2 = SDL_GetTicks();
     }
 
+    // Overrides the current frame's delta, e.g. when replaying recorded input
+    void setDeltaTime(int ms)
+    {
+        dTime1 = dTime2 - ms;
+    }
+
     void update()
     {
         dTime1 = dTime2;
         dTime2 = SDL_GetTicks();
     }
 
-    void delayByFPS()
+    // Counts a frame without waiting, for loops that aren't capped
+    void countFrame()
     {
         frames++;
+    }
+
+    void delayByFPS()
+    {
+        countFrame();
 
         int dt = SDL_GetTicks() - dTime2;
 
@@ -8,11 +8,33 @@
 #include "timer.h"
 #include "math.h"
 #include "image.h"
+#include "assets.h"
+#include "loader.h"
+#include "framebuffer.h"
+#include "camera.h"
+#include "renderqueue.h"
+#include "events.h"
 #include "keyboard.h"
 #include "io.h"
+#include "actions.h"
+#include "replay.h"
 
 void emscriptenLoop(void *arg);
 
+enum WY_Backend
+{
+    BACKEND_SDL,     // draw with SDL_Renderer into a target texture
+    BACKEND_SOFTWARE // draw into a CPU WY_Framebuffer, uploaded once per frame
+};
+
+struct WY_RenderStats
+{
+    int nFramesDrawn = 0;   // frames that redrew something and presented
+    int nFramesSkipped = 0; // retained-mode frames with nothing dirty, not presented
+    int nDirtyRects = 0;    // regions redrawn in the last drawn frame
+    int nDirtyPixels = 0;   // game pixels redrawn in the last drawn frame
+};
+
 class Wyngine
 {
 protected:
@@ -22,14 +44,33 @@ protected:
     int mGamePS; // pixel size
     bool mGameRunning;
 
-    SDL_Event windowEvent;
+    WY_EventBuffer *events; // every event since last frame, see events.h
     SDL_Window *mWindow = NULL;
     SDL_Renderer *mRenderer = NULL;
     SDL_Texture *mTexture = NULL;
+    WY_Backend mBackend;
+    WY_Framebuffer *framebuffer = nullptr; // only with BACKEND_SOFTWARE
 
     WY_Timer *timer;
     WY_Keyboard *keyboard;
     WY_IO *io;
+    WY_ActionMap *actions; // named actions bound to keys, see actions.h
+    WY_AssetCache *assets = nullptr;
+    WY_ImageLoader *loader = nullptr;
+    WY_Camera *camera; // view into the game world, see camera.h
+    WY_RenderQueue *queue = nullptr; // sorted, batched draws; flushed after each onRender (BACKEND_SDL only)
+
+    // Input recording/replay, see replay.h
+    WY_InputLog *inputLog = nullptr;
+    bool bHeadless = false; // replaying with a hidden window and no frame cap
+    Uint64 nReplayStart = 0;
+
+    // Retained rendering: mTexture keeps last frame's picture and only dirty regions are redrawn
+    bool bRetained = false;
+    bool bAllDirty = true;
+    std::vector<SDL_Rect> mDirtyRects;
+    SDL_Rect mRedrawRect{0, 0, 0, 0}; // region being redrawn by the current onRender call
+    WY_RenderStats mRenderStats;
 
     bool init()
     {
@@ -58,26 +99,195 @@ protected:
 
         SDL_SetRenderDrawColor(mRenderer, 0x00, 0xFF, 0x00, 0xFF);
 
-        mTexture = SDL_CreateTexture(mRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, mGameW, mGameH);
+        if (mBackend == BACKEND_SOFTWARE)
+        {
+            mTexture = SDL_CreateTexture(mRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, mGameW, mGameH);
+            framebuffer = new WY_Framebuffer(mGameW, mGameH);
+        }
+        else
+        {
+            mTexture = SDL_CreateTexture(mRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, mGameW, mGameH);
+            queue = new WY_RenderQueue(mRenderer);
+        }
+
+        assets = new WY_AssetCache(mRenderer);
+        loader = new WY_ImageLoader(assets);
+
+        return true;
+    }
+
+    // Clears rect (or everything) for redrawing and limits drawing to it.
+    // With bClear false it only resets the limit.
+    void clearRegion(const SDL_Rect *rect, bool bClear = true)
+    {
+        if (framebuffer != nullptr)
+        {
+            framebuffer->setClip(rect);
+            if (bClear)
+            {
+                framebuffer->clear(0xEEEEEEFF);
+            }
+            return;
+        }
+
+        SDL_RenderSetClipRect(mRenderer, rect);
+        if (!bClear)
+        {
+            return;
+        }
+
+        SDL_SetRenderDrawColor(mRenderer, 0xEE, 0xEE, 0xEE, 0xFF);
+        if (rect == NULL)
+        {
+            SDL_RenderClear(mRenderer);
+        }
+        else
+        {
+            // SDL_RenderClear ignores the clip rect, so clear by filling
+            SDL_BlendMode blendMode;
+            SDL_GetRenderDrawBlendMode(mRenderer, &blendMode);
+            SDL_SetRenderDrawBlendMode(mRenderer, SDL_BLENDMODE_NONE);
+            SDL_RenderFillRect(mRenderer, rect);
+            SDL_SetRenderDrawBlendMode(mRenderer, blendMode);
+        }
+    }
+
+    // Merges overlapping dirty rects. Returns false when redrawing the whole
+    // screen would be about as cheap (many regions, or most of the screen).
+    bool mergeDirtyRects()
+    {
+        bool bMerged = true;
+        while (bMerged)
+        {
+            bMerged = false;
+            for (size_t i = 0; i < mDirtyRects.size(); i++)
+            {
+                for (size_t j = i + 1; j < mDirtyRects.size(); j++)
+                {
+                    if (SDL_HasIntersection(&mDirtyRects[i], &mDirtyRects[j]))
+                    {
+                        SDL_UnionRect(&mDirtyRects[i], &mDirtyRects[j], &mDirtyRects[i]);
+                        mDirtyRects.erase(mDirtyRects.begin() + j--);
+                        bMerged = true;
+                    }
+                }
+            }
+        }
+
+        int nPixels = 0;
+        for (auto &rect : mDirtyRects)
+        {
+            nPixels += rect.w * rect.h;
+        }
+
+        return mDirtyRects.size() <= 8 && nPixels * 4 < mGameW * mGameH * 3;
+    }
+
+    // Swaps this frame's live input for the next recorded frame.
+    // Returns false (and stops the game) when the replay is over.
+    bool replayFrame()
+    {
+        if (nReplayStart == 0)
+        {
+            nReplayStart = SDL_GetPerformanceCounter();
+        }
+
+        Uint64 keys[WY_KEY_WORDS];
+        int deltaMs;
+        if (!inputLog->readFrame(deltaMs, keys, *events))
+        {
+            double dElapsed = (SDL_GetPerformanceCounter() - nReplayStart) * 1000.0 / SDL_GetPerformanceFrequency();
+            int nFrames = inputLog->getFrameCount();
+            SDL_Log("Replay finished: %d frames in %.1f ms (%.3f ms per frame)\n", nFrames, dElapsed, nFrames > 0 ? dElapsed / nFrames : 0.0);
+
+            mGameRunning = false;
+            return false;
+        }
+
+        timer->setDeltaTime(deltaMs);
+        keyboard->update(*events, keys);
+
+        if (events->has(SDL_QUIT))
+        {
+            mGameRunning = false; // the recorded session ended here
+        }
 
         return true;
     }
 
+    // Draws whatever onRender recorded into the queue. Runs after each onRender;
+    // call it from onRender to put later immediate draws (e.g. a HUD) on top.
+    void flushQueue()
+    {
+        if (queue != nullptr)
+        {
+            queue->flush();
+        }
+    }
+
     virtual void onUpdate() {}
 
     virtual void onRender() {}
 
+    // ==================================================
+    // Retained rendering
+    // ==================================================
+    //
+    // By default the whole screen is cleared and redrawn every frame. In retained
+    // mode the game texture persists between frames instead: the game calls
+    // markDirty() for regions whose content changed, render() clears and redraws
+    // only those (calling onRender once per region, clipped to it), and when
+    // nothing is dirty the frame isn't drawn or presented at all.
+
+    void setRetainedMode(bool flag)
+    {
+        bRetained = flag;
+        bAllDirty = true;
+        mDirtyRects.clear();
+    }
+
+    bool isRetainedMode()
+    {
+        return bRetained;
+    }
+
+    // Region of the game screen (in game pixels) that must be redrawn this frame
+    void markDirty(SDL_Rect rect)
+    {
+        SDL_Rect screen = {0, 0, mGameW, mGameH};
+        if (SDL_IntersectRect(&rect, &screen, &rect))
+        {
+            mDirtyRects.push_back(rect);
+        }
+    }
+
+    void markAllDirty()
+    {
+        bAllDirty = true;
+    }
+
+    // Lets onRender skip drawing things that can't touch the region being redrawn.
+    // Always true outside retained mode.
+    bool isVisible(const SDL_Rect &rect)
+    {
+        return SDL_HasIntersection(&rect, &mRedrawRect) == SDL_TRUE;
+    }
+
 public:
-    Wyngine(const char *title, int w, int h, int ps)
+    Wyngine(const char *title, int w, int h, int ps, WY_Backend backend = BACKEND_SDL)
     {
         windowTitle = title;
+        mBackend = backend;
         mGameW = w;
         mGameH = h;
         mGamePS = ps;
 
         timer = new WY_Timer(60);
+        events = new WY_EventBuffer();
         keyboard = new WY_Keyboard();
         io = new WY_IO();
+        actions = new WY_ActionMap();
+        camera = new WY_Camera(w, h);
 
         if (init())
         {
@@ -87,11 +297,49 @@ public:
 
     Wyngine() : Wyngine("Wyngine", 640, 480, 1) {}
 
+    WY_Backend getBackend()
+    {
+        return mBackend;
+    }
+
+    const WY_RenderStats &getRenderStats()
+    {
+        return mRenderStats;
+    }
+
+    const WY_EventStats &getEventStats()
+    {
+        return events->getStats();
+    }
+
+    // Records input to log, or plays it back if log was opened with replay().
+    // A headless replay hides the window and runs as fast as it can.
+    void setInputLog(WY_InputLog *log, bool headless = false)
+    {
+        inputLog = log;
+        nReplayStart = 0;
+        bHeadless = headless && log != nullptr && log->isReplaying();
+
+        if (bHeadless)
+        {
+            SDL_HideWindow(mWindow);
+        }
+    }
+
     ~Wyngine()
     {
         delete timer;
+        delete events;
         delete keyboard;
         delete io;
+        delete actions;
+        delete camera;
+
+        // Cached textures must go before the renderer that owns them
+        delete queue;
+        delete loader;
+        delete assets;
+        delete framebuffer;
 
         SDL_DestroyRenderer(mRenderer);
         mRenderer = NULL;
@@ -109,17 +357,50 @@ public:
     {
         // perform internal physics here
 
-        int hasEvent = SDL_PollEvent(&windowEvent) != 0;
-        if (hasEvent)
+        // Take everything that's queued, not just one event per frame
+        events->poll();
+
+        for (const SDL_Event &event : *events)
         {
-            if (windowEvent.type == SDL_QUIT)
+            if (event.type == SDL_QUIT)
             {
                 mGameRunning = false;
             }
+
+            // The window or render targets lost their content; redraw everything
+            if ((event.type == SDL_WINDOWEVENT &&
+                 (event.window.event == SDL_WINDOWEVENT_EXPOSED || event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)) ||
+                event.type == SDL_RENDER_TARGETS_RESET || event.type == SDL_RENDER_DEVICE_RESET)
+            {
+                bAllDirty = true;
+            }
         }
 
-        keyboard->update(&windowEvent);
-        io->update(&windowEvent, hasEvent);
+        if (inputLog != nullptr && inputLog->isReplaying())
+        {
+            if (!replayFrame())
+            {
+                return;
+            }
+        }
+        else
+        {
+            keyboard->update(*events);
+        }
+
+        io->update(*events);
+        actions->update(keyboard, *events);
+
+        if (inputLog != nullptr && inputLog->isRecording())
+        {
+            inputLog->writeFrame(timer->getDeltaTime(), keyboard->getState(), *events);
+        }
+
+        if (loader != nullptr)
+        {
+            // Finish async image loads within this frame's upload budget
+            loader->update();
+        }
 
         onUpdate();
     }
@@ -128,13 +409,64 @@ public:
     {
         // perform internal render here
 
-        SDL_SetRenderTarget(mRenderer, mTexture);
+        if (bRetained && !bAllDirty && mDirtyRects.empty())
+        {
+            // Nothing changed; the last presented frame is still correct
+            mRenderStats.nFramesSkipped++;
+            return;
+        }
 
-        // Clear with magenta so we know this works
-        SDL_SetRenderDrawColor(mRenderer, 0xEE, 0xEE, 0xEE, 0xFF);
-        SDL_RenderClear(mRenderer);
+        if (framebuffer == nullptr)
+        {
+            SDL_SetRenderTarget(mRenderer, mTexture);
+        }
+
+        if (bRetained && !bAllDirty && mergeDirtyRects())
+        {
+            mRenderStats.nDirtyRects = mDirtyRects.size();
+            mRenderStats.nDirtyPixels = 0;
+
+            for (auto &rect : mDirtyRects)
+            {
+                mRedrawRect = rect;
+                mRenderStats.nDirtyPixels += rect.w * rect.h;
 
-        onRender();
+                clearRegion(&rect);
+                onRender();
+                flushQueue();
+            }
+
+            clearRegion(NULL, false);
+
+            if (framebuffer != nullptr)
+            {
+                // Only the redrawn regions need uploading
+                for (auto &rect : mDirtyRects)
+                {
+                    SDL_UpdateTexture(mTexture, &rect, framebuffer->row(rect.y) + rect.x, framebuffer->getPitch());
+                }
+            }
+        }
+        else
+        {
+            mRedrawRect = {0, 0, mGameW, mGameH};
+            mRenderStats.nDirtyRects = 1;
+            mRenderStats.nDirtyPixels = mGameW * mGameH;
+
+            clearRegion(NULL);
+            onRender();
+            flushQueue();
+
+            if (framebuffer != nullptr)
+            {
+                // The one upload of the frame
+                SDL_UpdateTexture(mTexture, NULL, framebuffer->getPixels(), framebuffer->getPitch());
+            }
+        }
+
+        bAllDirty = false;
+        mDirtyRects.clear();
+        mRenderStats.nFramesDrawn++;
 
         // Unset mTexture as render target before rendering mTexture to mRenderer
         SDL_SetRenderTarget(mRenderer, NULL);
@@ -157,7 +489,14 @@ public:
         // FPS capping already handled by emscripten_set_main_loop_arg.
         // Calling delayByFPS here will introduce stutter/latency in audio.
 #else
-        timer->delayByFPS();
+        if (bHeadless)
+        {
+            timer->countFrame();
+        }
+        else
+        {
+            timer->delayByFPS();
+        }
 #endif
     }
 